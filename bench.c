@@ -0,0 +1,1372 @@
+/**
+ * Simple benchmark program for RIFF file reader
+ *
+ * nested: generates a synthetic RIFF file with deeply nested LIST chunks
+ *         and long runs of empty LIST chunks, then measures iteration throughput.
+ * access: generates a large flat RIFF file and measures cold cache scan
+ *         times for each file access mode.
+ * batch:  generates a directory of WAV shaped files of mixed sizes and
+ *         measures batch scan throughput for different thread counts.
+ * index:  generates a large flat RIFF file and measures cold cache chunk
+ *         index build times, sequential and parallel.
+ * pcm:    generates stereo WAV files of 16, 24 and 32 bit samples and
+ *         measures PCM conversion throughput for each instruction set.
+ * fourcc: generates a flat RIFF file of tiny AVI shaped chunks and measures
+ *         chunk classification by memcmp against FourCC integer switch.
+ * suite:  generates a deterministic corpus of WAV, AVI and WEBP shaped files,
+ *         flat, deeply nested, millions of tiny chunks and few huge chunks,
+ *         then measures open and full iteration of each file. One JSON object
+ *         per file is printed with chunks/s, bytes/s, page faults and RSS.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <riff_file_reader.h>
+#include <riff_file_batch.h>
+#include <riff_file_wav.h>
+#include <riff_file_pcm.h>
+#include <riff_file_writer.h>
+
+//--------------------------------------------------
+
+// Default files generated by benchmark
+#define BENCH_DEFAULT_FILENAME        "/tmp/riff_bench_nested.riff"
+#define BENCH_ACCESS_DEFAULT_FILENAME "/tmp/riff_bench_access.riff"
+#define BENCH_BATCH_DEFAULT_DIRNAME   "/tmp/riff_bench_batch"
+#define BENCH_PCM_DEFAULT_FILENAME    "/tmp/riff_bench_pcm.wav"
+#define BENCH_FOURCC_DEFAULT_FILENAME "/tmp/riff_bench_fourcc.riff"
+#define BENCH_SUITE_DEFAULT_DIRNAME   "/tmp/riff_bench_suite"
+#define BENCH_WRITE_DEFAULT_FILENAME  "/tmp/riff_bench_write.avi"
+#define BENCH_RF64_DEFAULT_FILENAME   "/tmp/riff_bench_rf64.wav"
+
+// Nested LIST levels per block, fits in inline nesting levels of iterator
+#define BENCH_NESTED_LEVELS (9)
+// Number of empty LIST chunks after each nested block
+#define BENCH_EMPTY_LISTS   (64)
+// Number of blocks in file
+#define BENCH_BLOCKS        (20000)
+// Number of full iterations measured
+#define BENCH_ROUNDS        (10)
+// Descriptors fetched per batch iteration call
+#define BENCH_BATCH_DESCS   (256)
+
+// Chunks and chunk size in access benchmark file
+#define BENCH_ACCESS_CHUNKS     (4096)
+#define BENCH_ACCESS_CHUNK_SIZE (64 * 1024)
+// Stride used when touching payload
+#define BENCH_PAGE_SIZE         (4096)
+
+// Files in batch benchmark, data chunk sizes cycle from 1 KiB up to 1 MiB
+#define BENCH_BATCH_FILES       (2000)
+#define BENCH_BATCH_SIZE_STEPS  (11)
+
+// Stereo frames in PCM benchmark files, and conversion rounds measured
+#define BENCH_PCM_FRAMES        (4 * 1024 * 1024)
+#define BENCH_PCM_ROUNDS        (5)
+
+// Chunks in FourCC benchmark file, and classification rounds measured
+#define BENCH_FOURCC_CHUNKS     (1024 * 1024)
+#define BENCH_FOURCC_ROUNDS     (20)
+
+// Suite corpus shapes
+#define BENCH_SUITE_FLAT_CHUNKS     (16 * 1024)
+#define BENCH_SUITE_FLAT_MAX_SIZE   (8 * 1024)
+#define BENCH_SUITE_DEEP_BLOCKS     (20000)
+#define BENCH_SUITE_DEEP_LEVELS     (48)
+#define BENCH_SUITE_TINY_CHUNKS     (2 * 1024 * 1024)
+#define BENCH_SUITE_FRAMES          (1024 * 1024)
+#define BENCH_SUITE_HUGE_CHUNKS     (4)
+#define BENCH_SUITE_HUGE_SIZE       (512ull * 1024 * 1024)
+// Warm rounds measured per file, best round is reported
+#define BENCH_SUITE_ROUNDS          (5)
+
+// Video and audio frame pairs in write benchmark, every key frame is large
+#define BENCH_WRITE_FRAMES          (256 * 1024)
+#define BENCH_WRITE_KEY_INTERVAL    (32)
+#define BENCH_WRITE_KEY_SIZE        (96 * 1024)
+#define BENCH_WRITE_AUDIO_SIZE      (1411)
+#define BENCH_WRITE_ROUNDS          (3)
+
+// Seconds a walk of crafted RF64 file may take, a walk that does not end fails the run
+#define BENCH_RF64_TIMEOUT          (10)
+// Chunks in crafted RF64 file around chunk with bogus ds64 size
+#define BENCH_RF64_CHUNKS           (64)
+
+//--------------------------------------------------
+
+struct bench_buf_s
+{
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+};
+
+static void buf_put(struct bench_buf_s *b, const void *data, size_t len)
+{
+  if (b->size + len > b->capacity) {
+    while (b->size + len > b->capacity) {
+      b->capacity = (b->capacity == 0) ? 4096 : (b->capacity * 2);
+    }
+    b->data = (uint8_t *)realloc(b->data, b->capacity);
+    if (b->data == NULL) {
+      perror("realloc bench buffer failed");
+      exit(1);
+    }
+  }
+  memcpy(b->data + b->size, data, len);
+  b->size += len;
+}
+
+static void buf_put_u32(struct bench_buf_s *b, uint32_t v)
+{
+  uint8_t le[4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff };
+  buf_put(b, le, 4);
+}
+
+static void buf_put_u64(struct bench_buf_s *b, uint64_t v)
+{
+  buf_put_u32(b, (uint32_t)v);
+  buf_put_u32(b, (uint32_t)(v >> 32));
+}
+
+static void buf_patch_u32(struct bench_buf_s *b, size_t pos, uint32_t v)
+{
+  b->data[pos + 0] = v & 0xff;
+  b->data[pos + 1] = (v >> 8) & 0xff;
+  b->data[pos + 2] = (v >> 16) & 0xff;
+  b->data[pos + 3] = (v >> 24) & 0xff;
+}
+
+// begin chunk, returns position of size field to patch
+static size_t buf_begin(struct bench_buf_s *b, const char id[4], const char *type)
+{
+  buf_put(b, id, 4);
+  size_t pos = b->size;
+  buf_put_u32(b, 0);
+  if (type != NULL) {
+    buf_put(b, type, 4);
+  }
+  return pos;
+}
+
+static void buf_end(struct bench_buf_s *b, size_t pos)
+{
+  buf_patch_u32(b, pos, (uint32_t)(b->size - pos - 4));
+}
+
+static void buf_data_chunk(struct bench_buf_s *b, const char id[4], uint32_t size)
+{
+  size_t pos = buf_begin(b, id, NULL);
+  uint32_t i;
+  for (i = 0; i < size; i++) {
+    uint8_t v = (uint8_t)i;
+    buf_put(b, &v, 1);
+  }
+  buf_end(b, pos);
+}
+
+static void gen_nested(struct bench_buf_s *b, int level)
+{
+  size_t pos = buf_begin(b, "LIST", "nest");
+  buf_data_chunk(b, "data", 4);
+  if (level > 1) {
+    gen_nested(b, level - 1);
+  }
+  buf_end(b, pos);
+}
+
+//--------------------------------------------------
+static int write_file(const char *filename, struct bench_buf_s *b)
+{
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL) {
+    perror("bench file open failed");
+    free(b->data);
+    return -1;
+  }
+  size_t written = fwrite(b->data, 1, b->size, fp);
+  fclose(fp);
+  free(b->data);
+  if (written != b->size) {
+    perror("bench file write failed");
+    return -1;
+  }
+  return 0;
+}
+
+//--------------------------------------------------
+static int generate_nested(const char *filename)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  int i, j;
+
+  size_t riff = buf_begin(&b, "RIFF", "BNCH");
+  for (i = 0; i < BENCH_BLOCKS; i++) {
+    gen_nested(&b, BENCH_NESTED_LEVELS);
+    for (j = 0; j < BENCH_EMPTY_LISTS; j++) {
+      size_t pos = buf_begin(&b, "LIST", "empt");
+      buf_end(&b, pos);
+    }
+    buf_data_chunk(&b, "tail", 4);
+  }
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+//--------------------------------------------------
+static int generate_access(const char *filename)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  int i;
+
+  size_t riff = buf_begin(&b, "RIFF", "BNCH");
+  for (i = 0; i < BENCH_ACCESS_CHUNKS; i++) {
+    buf_data_chunk(&b, "blob", BENCH_ACCESS_CHUNK_SIZE);
+  }
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+//--------------------------------------------------
+static int generate_batch_file(const char *filename, uint32_t data_size)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+
+  size_t riff = buf_begin(&b, "RIFF", "WAVE");
+  buf_data_chunk(&b, "fmt ", 16);
+  size_t info = buf_begin(&b, "LIST", "INFO");
+  buf_data_chunk(&b, "INAM", 8);
+  buf_data_chunk(&b, "ISFT", 8);
+  buf_end(&b, info);
+  buf_data_chunk(&b, "data", data_size);
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+//--------------------------------------------------
+static int generate_pcm(const char *filename, uint16_t bits)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  uint16_t block_align = 2 * (bits / 8);
+
+  size_t riff = buf_begin(&b, "RIFF", "WAVE");
+  size_t fmt = buf_begin(&b, "fmt ", NULL);
+  uint8_t format[16] = { 1, 0, 2, 0, 0x80, 0xbb, 0, 0, 0, 0, 0, 0,
+                         block_align & 0xff, block_align >> 8, bits & 0xff, bits >> 8 };
+  buf_put(&b, format, sizeof(format));
+  buf_end(&b, fmt);
+  buf_patch_u32(&b, fmt + 12, 48000 * block_align);
+  buf_data_chunk(&b, "data", BENCH_PCM_FRAMES * block_align);
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+//--------------------------------------------------
+// chunk ids seen in AVI files, classified by fourcc benchmark
+static const char bench_fourcc_ids[][4] = {
+  "strh", "strf", "strd", "strn", "indx", "avih", "idx1", "JUNK", "00dc", "01wb", "ix00", "ISFT",
+};
+#define BENCH_FOURCC_IDS (sizeof(bench_fourcc_ids) / sizeof(bench_fourcc_ids[0]))
+
+static int generate_fourcc(const char *filename)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  int i;
+
+  // ids repeat in fixed order, like interleaved stream chunks
+  size_t riff = buf_begin(&b, "RIFF", "AVI ");
+  for (i = 0; i < BENCH_FOURCC_CHUNKS; i++) {
+    buf_data_chunk(&b, bench_fourcc_ids[i % BENCH_FOURCC_IDS], 4);
+  }
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+//--------------------------------------------------
+// deterministic pseudo random numbers for corpus, same files on every run
+static uint32_t suite_rand(uint32_t *seed)
+{
+  *seed = *seed * 1103515245u + 12345u;
+  return *seed >> 16;
+}
+
+// WAV with many medium sized chunks at top level
+static int generate_suite_wav_flat(const char *filename)
+{
+  static const char ids[][4] = { "cue ", "smpl", "inst", "bext", "JUNK", "data" };
+  struct bench_buf_s b = { NULL, 0, 0 };
+  uint32_t seed = 1;
+  int i;
+
+  size_t riff = buf_begin(&b, "RIFF", "WAVE");
+  buf_data_chunk(&b, "fmt ", 16);
+  for (i = 0; i < BENCH_SUITE_FLAT_CHUNKS; i++) {
+    // even sizes, buffer generator writes no pad bytes
+    uint32_t size = 2 + 2 * (suite_rand(&seed) % (BENCH_SUITE_FLAT_MAX_SIZE / 2));
+    buf_data_chunk(&b, ids[i % (sizeof(ids) / sizeof(ids[0]))], size);
+  }
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+// WAV with few huge data chunks, payload is left as holes in sparse file
+static int generate_suite_wav_huge(const char *filename)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  uint64_t size = 4 + 8 + 16 + BENCH_SUITE_HUGE_CHUNKS * (8 + BENCH_SUITE_HUGE_SIZE);
+  int i;
+
+  // RF64 is not needed as long as file stays below 4 GiB
+  buf_put(&b, "RIFF", 4);
+  buf_put_u32(&b, (uint32_t)size);
+  buf_put(&b, "WAVE", 4);
+  buf_data_chunk(&b, "fmt ", 16);
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL) {
+    perror("bench file open failed");
+    free(b.data);
+    return -1;
+  }
+  bool ok = (fwrite(b.data, 1, b.size, fp) == b.size);
+  free(b.data);
+  for (i = 0; ok && (i < BENCH_SUITE_HUGE_CHUNKS); i++) {
+    uint8_t hdr[8] = { 'd', 'a', 't', 'a',
+                       BENCH_SUITE_HUGE_SIZE & 0xff, (BENCH_SUITE_HUGE_SIZE >> 8) & 0xff,
+                       (BENCH_SUITE_HUGE_SIZE >> 16) & 0xff, (BENCH_SUITE_HUGE_SIZE >> 24) & 0xff };
+    ok = (fwrite(hdr, 1, sizeof(hdr), fp) == sizeof(hdr)) &&
+         (fseeko(fp, (off_t)BENCH_SUITE_HUGE_SIZE, SEEK_CUR) == 0);
+  }
+  // extend file over last hole
+  ok = ok && (fflush(fp) == 0) && (ftruncate(fileno(fp), (off_t)(size + 8)) == 0);
+  if ((fclose(fp) != 0) || !ok) {
+    perror("bench file write failed");
+    return -1;
+  }
+  return 0;
+}
+
+// AVI with header lists and movi list of one million small interleaved frames
+static int generate_suite_avi_frames(const char *filename)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  uint32_t seed = 2;
+  int i;
+
+  size_t riff = buf_begin(&b, "RIFF", "AVI ");
+  size_t hdrl = buf_begin(&b, "LIST", "hdrl");
+  buf_data_chunk(&b, "avih", 56);
+  for (i = 0; i < 2; i++) {
+    size_t strl = buf_begin(&b, "LIST", "strl");
+    buf_data_chunk(&b, "strh", 56);
+    buf_data_chunk(&b, "strf", (i == 0) ? 40 : 18);
+    buf_end(&b, strl);
+  }
+  buf_end(&b, hdrl);
+  size_t movi = buf_begin(&b, "LIST", "movi");
+  for (i = 0; i < BENCH_SUITE_FRAMES; i++) {
+    if (i & 1) {
+      buf_data_chunk(&b, "01wb", 8);
+    }
+    else {
+      buf_data_chunk(&b, "00dc", 16 + 2 * (suite_rand(&seed) % 24));
+    }
+  }
+  buf_end(&b, movi);
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+// AVI with LIST chunks nested deeper than iterator keeps inline, chunk at every level
+static void gen_suite_deep(struct bench_buf_s *b, int level)
+{
+  size_t pos = buf_begin(b, "LIST", "rec ");
+  buf_data_chunk(b, "00dc", 4);
+  if (level > 1) {
+    gen_suite_deep(b, level - 1);
+  }
+  buf_end(b, pos);
+}
+
+static int generate_suite_avi_deep(const char *filename)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  int i;
+
+  size_t riff = buf_begin(&b, "RIFF", "AVI ");
+  for (i = 0; i < BENCH_SUITE_DEEP_BLOCKS; i++) {
+    gen_suite_deep(&b, BENCH_SUITE_DEEP_LEVELS);
+  }
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+// animated WEBP with millions of tiny frame chunks at top level
+static int generate_suite_webp_tiny(const char *filename)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  int i;
+
+  size_t riff = buf_begin(&b, "RIFF", "WEBP");
+  buf_data_chunk(&b, "VP8X", 10);
+  buf_data_chunk(&b, "ANIM", 6);
+  for (i = 0; i < BENCH_SUITE_TINY_CHUNKS; i++) {
+    buf_data_chunk(&b, "ANMF", 4);
+  }
+  buf_end(&b, riff);
+
+  return write_file(filename, &b);
+}
+
+//--------------------------------------------------
+static double now_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//--------------------------------------------------
+static uint64_t bench_list_events;
+
+static void bench_list_start_fn(riff_file_data_chunk_iterator_h iter_h, int level,
+                                const char type[4], size_t size, const char format[4])
+{
+  bench_list_events++;
+}
+
+static void bench_list_end_fn(riff_file_data_chunk_iterator_h iter_h, int level)
+{
+  bench_list_events++;
+}
+
+//--------------------------------------------------
+// walk with one descriptor per call and list callbacks, then with batches holding lists inline
+static int bench_nested_desc(riff_file_h rf)
+{
+  struct riff_file_chunk_desc_s descs[BENCH_BATCH_DESCS];
+  uint64_t items = 0;
+  int round;
+
+  bench_list_events = 0;
+  double start = now_sec();
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+    riff_file_data_chunk_iterator_h iter_h =
+      riff_file_data_chunk_iterator_new(rf, bench_list_start_fn, bench_list_end_fn);
+    if (iter_h == NULL) {
+      return 1;
+    }
+    while (riff_file_data_chunk_iterator_next_desc(iter_h, &descs[0]) > 0) {
+      items++;
+    }
+    riff_file_data_chunk_iterator_delete(iter_h);
+  }
+  double elapsed = now_sec() - start;
+  items += bench_list_events;
+  printf("nested desc : %llu items in %.3f s, %.0f items/s\n",
+         (unsigned long long)items, elapsed, items / elapsed);
+
+  items = 0;
+  start = now_sec();
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+    riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf, NULL, NULL);
+    if (iter_h == NULL) {
+      return 1;
+    }
+    int32_t n;
+    while ((n = riff_file_data_chunk_iterator_next_batch(iter_h, descs, BENCH_BATCH_DESCS)) > 0) {
+      items += n;
+    }
+    riff_file_data_chunk_iterator_delete(iter_h);
+  }
+  elapsed = now_sec() - start;
+  printf("nested batch: %llu items in %.3f s, %.0f items/s\n",
+         (unsigned long long)items, elapsed, items / elapsed);
+  return 0;
+}
+
+//--------------------------------------------------
+static int bench_nested(const char *filename)
+{
+  if (generate_nested(filename) != 0) {
+    return 1;
+  }
+
+  riff_file_h rf = riff_file_open(filename, "BNCH");
+  if (rf == NULL) {
+    return 1;
+  }
+
+  uint64_t chunks = 0;
+  double start = now_sec();
+  int round;
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+    riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf, NULL, NULL);
+    if (iter_h == NULL) {
+      riff_file_close(rf);
+      return 1;
+    }
+    while (riff_file_data_chunk_iterator_next(iter_h) != NULL) {
+      chunks++;
+    }
+    riff_file_data_chunk_iterator_delete(iter_h);
+  }
+  double elapsed = now_sec() - start;
+
+  // every block holds one LIST per level plus the empty LIST run
+  uint64_t lists = (uint64_t)BENCH_ROUNDS * BENCH_BLOCKS * (BENCH_NESTED_LEVELS + BENCH_EMPTY_LISTS);
+  printf("nested: %llu chunks %llu lists in %.3f s, %.0f chunks/s %.0f headers/s\n",
+         (unsigned long long)chunks, (unsigned long long)lists, elapsed,
+         chunks / elapsed, (chunks + lists) / elapsed);
+
+  int res = bench_nested_desc(rf);
+  riff_file_close(rf);
+  return res;
+}
+
+//--------------------------------------------------
+static int drop_file_cache(const char *filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    perror("bench file open failed");
+    return -1;
+  }
+  // only clean and unmapped pages are dropped, good enough for a freshly written file
+  fdatasync(fd);
+  int res = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+  return res;
+}
+
+//--------------------------------------------------
+static int scan_cold(const char *filename, const struct riff_file_open_options_s *options,
+                     bool touch_payload, double *elapsed)
+{
+  if (drop_file_cache(filename) != 0) {
+    return -1;
+  }
+
+  double start = now_sec();
+  riff_file_h rf = riff_file_open_ex(filename, "BNCH", options);
+  if (rf == NULL) {
+    return -1;
+  }
+  riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf, NULL, NULL);
+  if (iter_h == NULL) {
+    riff_file_close(rf);
+    return -1;
+  }
+  static uint8_t payload[BENCH_ACCESS_CHUNK_SIZE];
+  bool mapped = (riff_file_get_backend(rf) == RIFF_FILE_BACKEND_MMAP);
+  struct riff_file_chunk_desc_s desc;
+  volatile uint32_t sum = 0;
+  while (riff_file_data_chunk_iterator_next_desc(iter_h, &desc) > 0) {
+    if (touch_payload) {
+      const uint8_t *data = payload;
+      if (mapped) {
+        data = riff_file_get_chunk(rf, &desc)->data;
+      }
+      else if (riff_file_read(rf, desc.offset + 8, payload, desc.size) != 0) {
+        break;
+      }
+      uint32_t i;
+      for (i = 0; i < desc.size; i += BENCH_PAGE_SIZE) {
+        sum += data[i];
+      }
+    }
+  }
+  riff_file_data_chunk_iterator_delete(iter_h);
+  riff_file_close(rf);
+  *elapsed = now_sec() - start;
+  return 0;
+}
+
+//--------------------------------------------------
+static int bench_access(const char *filename)
+{
+  static const struct {
+    const char *name;
+    struct riff_file_open_options_s options;
+  } modes[] = {
+    { "default",      { RIFF_FILE_ACCESS_DEFAULT,      false, RIFF_FILE_BACKEND_MMAP,     false } },
+    { "sequential",   { RIFF_FILE_ACCESS_SEQUENTIAL,   false, RIFF_FILE_BACKEND_MMAP,     false } },
+    { "random",       { RIFF_FILE_ACCESS_RANDOM,       false, RIFF_FILE_BACKEND_MMAP,     false } },
+    { "headers_only", { RIFF_FILE_ACCESS_HEADERS_ONLY, false, RIFF_FILE_BACKEND_MMAP,     false } },
+    { "populate",     { RIFF_FILE_ACCESS_DEFAULT,      true,  RIFF_FILE_BACKEND_MMAP,     false } },
+    { "pread",        { RIFF_FILE_ACCESS_SEQUENTIAL,   false, RIFF_FILE_BACKEND_PREAD,    false } },
+    { "io_uring",     { RIFF_FILE_ACCESS_SEQUENTIAL,   false, RIFF_FILE_BACKEND_IO_URING, false } },
+  };
+
+  if (generate_access(filename) != 0) {
+    return 1;
+  }
+
+  size_t i;
+  for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+    double headers, full;
+    if ((scan_cold(filename, &modes[i].options, false, &headers) != 0) ||
+        (scan_cold(filename, &modes[i].options, true, &full) != 0)) {
+      return 1;
+    }
+    printf("access %-12s: headers %.3f s, payload %.3f s\n", modes[i].name, headers, full);
+  }
+  return 0;
+}
+
+//--------------------------------------------------
+static void batch_result_fn(const struct riff_file_batch_result_s *result, void *user)
+{
+  uint64_t *totals = (uint64_t *)user;
+  if (result->status == 0) {
+    totals[0]++;
+    totals[1] += result->file_size;
+  }
+}
+
+//--------------------------------------------------
+static int bench_batch(const char *dirname)
+{
+  static const int32_t threads[] = { 1, 2, 4, 0 };
+  char **paths = (char **)malloc(BENCH_BATCH_FILES * sizeof(char *));
+  if (paths == NULL) {
+    return 1;
+  }
+  mkdir(dirname, 0755);
+
+  int i;
+  for (i = 0; i < BENCH_BATCH_FILES; i++) {
+    paths[i] = (char *)malloc(strlen(dirname) + 32);
+    sprintf(paths[i], "%s/file%05d.wav", dirname, i);
+    if (generate_batch_file(paths[i], 1024u << (i % BENCH_BATCH_SIZE_STEPS)) != 0) {
+      return 1;
+    }
+  }
+
+  size_t t;
+  for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+    uint64_t totals[2] = { 0, 0 };
+    double start = now_sec();
+    if (riff_file_batch_scan((const char *const *)paths, BENCH_BATCH_FILES, "WAVE", threads[t],
+                             NULL, batch_result_fn, totals) != 0) {
+      return 1;
+    }
+    double elapsed = now_sec() - start;
+    printf("batch threads %d: %llu files %llu bytes in %.3f s, %.0f files/s\n",
+           (int)threads[t], (unsigned long long)totals[0], (unsigned long long)totals[1],
+           elapsed, totals[0] / elapsed);
+  }
+
+  for (i = 0; i < BENCH_BATCH_FILES; i++) {
+    free(paths[i]);
+  }
+  free(paths);
+  return 0;
+}
+
+//--------------------------------------------------
+static int index_cold(const char *filename, int32_t threads, double *elapsed, size_t *count)
+{
+  if (drop_file_cache(filename) != 0) {
+    return -1;
+  }
+  double start = now_sec();
+  riff_file_h rf = riff_file_open(filename, "BNCH");
+  if (rf == NULL) {
+    return -1;
+  }
+  riff_file_index_h index_h;
+  if (threads == 0) {
+    index_h = riff_file_index_get(rf);
+  }
+  else {
+    index_h = riff_file_index_get_parallel(rf, threads);
+  }
+  if (index_h == NULL) {
+    riff_file_close(rf);
+    return -1;
+  }
+  *count = riff_file_index_get_count(index_h);
+  riff_file_close(rf);
+  *elapsed = now_sec() - start;
+  return 0;
+}
+
+// build index of file in page cache, CPU bound, best of rounds
+//@return 0 on success, -1 on error
+static int index_warm(const char *filename, int32_t threads, double *elapsed, size_t *count)
+{
+  int round;
+  for (round = 0; round < BENCH_ROUNDS; round++) {
+    riff_file_h rf = riff_file_open(filename, "BNCH");
+    if (rf == NULL) {
+      return -1;
+    }
+    double start = now_sec();
+    riff_file_index_h index_h = (threads == 0) ? riff_file_index_get(rf) : riff_file_index_get_parallel(rf, threads);
+    double t = now_sec() - start;
+    if (index_h == NULL) {
+      riff_file_close(rf);
+      return -1;
+    }
+    *count = riff_file_index_get_count(index_h);
+    riff_file_close(rf);
+    if ((round == 0) || (t < *elapsed)) {
+      *elapsed = t;
+    }
+  }
+  return 0;
+}
+
+//--------------------------------------------------
+static int bench_index(const char *filename)
+{
+  static const int32_t threads[] = { 0, 1, 2, 4, 8 };
+
+  if ((generate_access(filename) != 0) || (generate_nested(BENCH_DEFAULT_FILENAME) != 0)) {
+    return 1;
+  }
+  printf("index cpus %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+
+  size_t t;
+  for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+    double elapsed;
+    size_t count;
+    if (index_cold(filename, threads[t], &elapsed, &count) != 0) {
+      return 1;
+    }
+    char label[32];
+    if (threads[t] == 0) {
+      strcpy(label, "sequential");
+    }
+    else {
+      sprintf(label, "threads %d", (int)threads[t]);
+    }
+    printf("index %-10s: %zu chunks in %.3f s\n", label, count, elapsed);
+  }
+  // many small nested chunks, file is in page cache so walk itself is measured
+  for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+    double elapsed;
+    size_t count;
+    if (index_warm(BENCH_DEFAULT_FILENAME, threads[t], &elapsed, &count) != 0) {
+      return 1;
+    }
+    if (threads[t] == 0) {
+      printf("index warm sequential: %zu entries in %.3f s\n", count, elapsed);
+    }
+    else {
+      printf("index warm threads %d : %zu entries in %.3f s\n", (int)threads[t], count, elapsed);
+    }
+  }
+  return 0;
+}
+
+//--------------------------------------------------
+static const char* pcm_isa_name(enum riff_file_pcm_isa_e isa)
+{
+  switch (isa) {
+  case RIFF_FILE_PCM_ISA_SSE2: return "sse2";
+  case RIFF_FILE_PCM_ISA_AVX2: return "avx2";
+  case RIFF_FILE_PCM_ISA_NEON: return "neon";
+  default:                     return "scalar";
+  }
+}
+
+//--------------------------------------------------
+static int bench_pcm(const char *filename)
+{
+  static const uint16_t bits[] = { 16, 24, 32 };
+  static const enum riff_file_pcm_isa_e isas[] = {
+    RIFF_FILE_PCM_ISA_SCALAR, RIFF_FILE_PCM_ISA_SSE2, RIFF_FILE_PCM_ISA_AVX2, RIFF_FILE_PCM_ISA_NEON,
+  };
+  enum riff_file_pcm_isa_e best = riff_file_pcm_get_isa();
+  size_t samples = (size_t)BENCH_PCM_FRAMES * 2;
+  float *out = (float *)malloc(samples * sizeof(float));
+  uint8_t *pcm = (uint8_t *)malloc(samples * 4);
+  if ((out == NULL) || (pcm == NULL)) {
+    perror("bench pcm buffer alloc failed");
+    free(out);
+    free(pcm);
+    return 1;
+  }
+  float *planes[2] = { out, out + BENCH_PCM_FRAMES };
+
+  size_t n, a;
+  for (n = 0; n < sizeof(bits) / sizeof(bits[0]); n++) {
+    if (generate_pcm(filename, bits[n]) != 0) {
+      break;
+    }
+    riff_file_wav_h wav = riff_file_wav_open(filename, NULL);
+    struct riff_file_wav_samples_s view;
+    if ((wav == NULL) || (riff_file_wav_get_samples(wav, &view) != 1)) {
+      printf("bench pcm file %s failed\n", filename);
+      if (wav != NULL) {
+        riff_file_wav_close(wav);
+      }
+      break;
+    }
+    for (a = 0; a < sizeof(isas) / sizeof(isas[0]); a++) {
+      if (riff_file_pcm_set_isa(isas[a]) != 0) {
+        continue;
+      }
+      int r;
+      double start = now_sec();
+      for (r = 0; r < BENCH_PCM_ROUNDS; r++) {
+        riff_file_pcm_to_float(out, view.data, view.sample_type, samples);
+      }
+      double interleaved = now_sec() - start;
+      start = now_sec();
+      for (r = 0; r < BENCH_PCM_ROUNDS; r++) {
+        riff_file_pcm_to_float_planar(planes, view.data, view.sample_type, view.channels, view.frame_count);
+      }
+      double planar = now_sec() - start;
+      start = now_sec();
+      for (r = 0; r < BENCH_PCM_ROUNDS; r++) {
+        riff_file_pcm_from_float(pcm, out, view.sample_type, samples);
+      }
+      double back = now_sec() - start;
+      double msamples = (double)samples * BENCH_PCM_ROUNDS / 1e6;
+      printf("pcm int%-2d %-6s: to float %7.1f Ms/s, planar %7.1f Ms/s, from float %7.1f Ms/s\n",
+             (int)bits[n], pcm_isa_name(isas[a]),
+             msamples / interleaved, msamples / planar, msamples / back);
+    }
+    riff_file_wav_close(wav);
+  }
+  riff_file_pcm_set_isa(best);
+  free(out);
+  free(pcm);
+  return (n == sizeof(bits) / sizeof(bits[0])) ? 0 : 1;
+}
+
+//--------------------------------------------------
+// classify chunk id by comparing with each known id in turn
+static __attribute__((noinline)) int bench_classify_memcmp(const char id[4])
+{
+  if (memcmp(id, "strh", 4) == 0) return 0;
+  if (memcmp(id, "strf", 4) == 0) return 1;
+  if (memcmp(id, "strd", 4) == 0) return 2;
+  if (memcmp(id, "strn", 4) == 0) return 3;
+  if (memcmp(id, "indx", 4) == 0) return 4;
+  if (memcmp(id, "avih", 4) == 0) return 5;
+  if (memcmp(id, "idx1", 4) == 0) return 6;
+  if (memcmp(id, "JUNK", 4) == 0) return 7;
+  if (memcmp(id, "00dc", 4) == 0) return 8;
+  if (memcmp(id, "01wb", 4) == 0) return 9;
+  if (memcmp(id, "ix00", 4) == 0) return 10;
+  if (memcmp(id, "ISFT", 4) == 0) return 11;
+  return -1;
+}
+
+// classify chunk id with one load and switch on FourCC integer
+static __attribute__((noinline)) int bench_classify_fourcc(const char id[4])
+{
+  switch (riff_file_fourcc(id)) {
+  case RIFF_FILE_FOURCC('s', 't', 'r', 'h'): return 0;
+  case RIFF_FILE_FOURCC('s', 't', 'r', 'f'): return 1;
+  case RIFF_FILE_FOURCC('s', 't', 'r', 'd'): return 2;
+  case RIFF_FILE_FOURCC('s', 't', 'r', 'n'): return 3;
+  case RIFF_FILE_FOURCC_INDX:                return 4;
+  case RIFF_FILE_FOURCC('a', 'v', 'i', 'h'): return 5;
+  case RIFF_FILE_FOURCC_IDX1:                return 6;
+  case RIFF_FILE_FOURCC_JUNK:                return 7;
+  case RIFF_FILE_FOURCC('0', '0', 'd', 'c'): return 8;
+  case RIFF_FILE_FOURCC('0', '1', 'w', 'b'): return 9;
+  case RIFF_FILE_FOURCC('i', 'x', '0', '0'): return 10;
+  case RIFF_FILE_FOURCC('I', 'S', 'F', 'T'): return 11;
+  default:                                   return -1;
+  }
+}
+
+//--------------------------------------------------
+static int bench_fourcc(const char *filename)
+{
+  if (generate_fourcc(filename) != 0) {
+    return 1;
+  }
+  riff_file_h rf = riff_file_open(filename, "AVI ");
+  if (rf == NULL) {
+    return 1;
+  }
+  struct riff_file_chunk_desc_s *descs =
+    (struct riff_file_chunk_desc_s *)malloc(BENCH_FOURCC_CHUNKS * sizeof(struct riff_file_chunk_desc_s));
+  riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf, NULL, NULL);
+  if ((descs == NULL) || (iter_h == NULL)) {
+    perror("bench fourcc alloc failed");
+    free(descs);
+    riff_file_close(rf);
+    return 1;
+  }
+
+  // descriptors are collected first so only classification is measured
+  size_t count = 0;
+  int32_t n;
+  while ((count < BENCH_FOURCC_CHUNKS) &&
+         ((n = riff_file_data_chunk_iterator_next_batch(iter_h, descs + count, BENCH_FOURCC_CHUNKS - count)) > 0)) {
+    count += (size_t)n;
+  }
+  riff_file_data_chunk_iterator_delete(iter_h);
+
+  uint64_t sums[2] = { 0, 0 };
+  double elapsed[2];
+  int m, r;
+  size_t i;
+  for (m = 0; m < 2; m++) {
+    double start = now_sec();
+    for (r = 0; r < BENCH_FOURCC_ROUNDS; r++) {
+      for (i = 0; i < count; i++) {
+        sums[m] += (m == 0) ? bench_classify_memcmp(descs[i].id) : bench_classify_fourcc(descs[i].id);
+      }
+    }
+    elapsed[m] = now_sec() - start;
+  }
+  double chunks = (double)count * BENCH_FOURCC_ROUNDS;
+  printf("fourcc memcmp: %zu chunks in %.3f s, %.2f ns/chunk\n", count, elapsed[0], elapsed[0] * 1e9 / chunks);
+  printf("fourcc switch: %zu chunks in %.3f s, %.2f ns/chunk\n", count, elapsed[1], elapsed[1] * 1e9 / chunks);
+
+  free(descs);
+  riff_file_close(rf);
+  return (sums[0] == sums[1]) ? 0 : 1;
+}
+
+//--------------------------------------------------
+// RF64 file with 64 bit size in ds64 that runs past end of file, for data chunk or
+// for LIST chunks through ds64 table, sizes near 2^64 used to wrap offsets around
+static int generate_rf64(const char *filename, bool list, uint64_t size)
+{
+  struct bench_buf_s b = { NULL, 0, 0 };
+  buf_put(&b, "RF64", 4);
+  buf_put_u32(&b, UINT32_MAX);
+  buf_put(&b, "WAVE", 4);
+  buf_put(&b, "ds64", 4);
+  buf_put_u32(&b, list ? (28 + 12) : 28);
+  buf_put_u64(&b, UINT64_MAX);
+  buf_put_u64(&b, list ? 16 : size);
+  buf_put_u64(&b, 0);
+  buf_put_u32(&b, list ? 1 : 0);
+  if (list) {
+    buf_put(&b, "LIST", 4);
+    buf_put_u64(&b, size);
+  }
+  size_t pos = buf_begin(&b, list ? "LIST" : "data", list ? "adtl" : NULL);
+  buf_patch_u32(&b, pos, UINT32_MAX);
+  int i;
+  for (i = 0; i < BENCH_RF64_CHUNKS; i++) {
+    buf_data_chunk(&b, "labl", 8);
+  }
+  return write_file(filename, &b);
+}
+
+static void rf64_batch_result(const struct riff_file_batch_result_s *result, void *user)
+{
+  *(struct riff_file_batch_result_s *)user = *result;
+}
+
+static void rf64_stream_chunk(void *user, int level, const char id[4], uint64_t size, uint64_t offset)
+{
+  (*(uint64_t *)user)++;
+}
+
+//--------------------------------------------------
+// every walk over crafted files must end and report clamped chunk size
+static int bench_rf64(const char *filename)
+{
+  static const struct {
+    const char *name;
+    bool list;
+    uint64_t size;
+    // stream does not know where RF64 stream ends, only sizes wrapping offset are caught
+    bool stream_caught;
+  } cases[] = {
+    { "data_wrap",  false, 0xfffffffffffffff8ull, true  },
+    { "data_large", false, 1ull << 40,            false },
+    { "list_wrap",  true,  0xfffffffffffffff0ull, true  },
+  };
+
+  // hang is turned into failure
+  alarm(BENCH_RF64_TIMEOUT);
+  size_t c;
+  for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    if (generate_rf64(filename, cases[c].list, cases[c].size) != 0) {
+      return 1;
+    }
+    double start = now_sec();
+    riff_file_h rf = riff_file_open(filename, "WAVE");
+    if (rf == NULL) {
+      return 1;
+    }
+    riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf, NULL, NULL);
+    if (iter_h == NULL) {
+      riff_file_close(rf);
+      return 1;
+    }
+    struct riff_file_chunk_desc_s desc;
+    uint64_t chunks = 0;
+    while (riff_file_data_chunk_iterator_next_desc(iter_h, &desc) > 0) {
+      chunks++;
+    }
+    enum riff_file_error_e error = riff_file_data_chunk_iterator_get_error(iter_h, NULL);
+    riff_file_data_chunk_iterator_delete(iter_h);
+
+    riff_file_index_h index_h = riff_file_index_get_parallel(rf, 0);
+    size_t entries = (index_h != NULL) ? riff_file_index_get_count(index_h) : 0;
+    riff_file_close(rf);
+
+    struct riff_file_batch_result_s result;
+    memset(&result, 0, sizeof(result));
+    const char *paths[1] = { filename };
+    riff_file_batch_scan(paths, 1, "WAVE", 1, NULL, rf64_batch_result, &result);
+
+    struct riff_file_stream_callbacks_s cb = { NULL, NULL, rf64_stream_chunk, NULL, NULL };
+    uint64_t stream_chunks = 0;
+    riff_file_stream_h stream_h = riff_file_stream_new("WAVE", &cb, &stream_chunks);
+    struct stat st;
+    uint8_t *data = NULL;
+    int fd = open(filename, O_RDONLY);
+    if ((stream_h == NULL) || (fd < 0) || (fstat(fd, &st) != 0) ||
+        ((data = (uint8_t *)malloc((size_t)st.st_size)) == NULL) ||
+        (read(fd, data, (size_t)st.st_size) != (ssize_t)st.st_size)) {
+      free(data);
+      if (fd >= 0) {
+        close(fd);
+      }
+      riff_file_stream_delete(stream_h);
+      return 1;
+    }
+    close(fd);
+    riff_file_stream_push(stream_h, data, (size_t)st.st_size);
+    riff_file_stream_finish(stream_h);
+    enum riff_file_error_e stream_error = riff_file_stream_get_error(stream_h, NULL);
+    riff_file_stream_delete(stream_h);
+    free(data);
+
+    printf("rf64 %-10s: iterator %llu chunks, index %zu entries, batch %llu chunks, stream %llu chunks, "
+           "%s in %.3f s\n", cases[c].name, (unsigned long long)chunks, entries,
+           (unsigned long long)result.chunk_count, (unsigned long long)stream_chunks,
+           riff_file_error_string(error), now_sec() - start);
+    if ((error != RIFF_FILE_ERROR_CHUNK_SIZE) || (result.error != RIFF_FILE_ERROR_CHUNK_SIZE) ||
+        (cases[c].stream_caught && (stream_error != RIFF_FILE_ERROR_CHUNK_SIZE)) || (index_h == NULL)) {
+      printf("rf64 %s: bogus ds64 size not reported\n", cases[c].name);
+      return 1;
+    }
+  }
+  alarm(0);
+  return 0;
+}
+
+//--------------------------------------------------
+// resident set size of process from /proc, 0 if not available
+static uint64_t suite_rss_kb(void)
+{
+  unsigned long size = 0;
+  unsigned long pages = 0;
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if (fp != NULL) {
+    if (fscanf(fp, "%lu %lu", &size, &pages) != 2) {
+      pages = 0;
+    }
+    fclose(fp);
+  }
+  return (uint64_t)pages * (uint64_t)sysconf(_SC_PAGESIZE) / 1024;
+}
+
+// open file and iterate all chunks and lists, rss is sampled before file is closed
+//@return 0 on success, -1 on error
+static int suite_iterate(const char *filename, const char *type, uint32_t flags,
+                         uint64_t *chunks, uint64_t *lists, uint64_t *rss_kb)
+{
+  struct riff_file_chunk_desc_s descs[BENCH_BATCH_DESCS];
+  riff_file_h rf = riff_file_open(filename, type);
+  if (rf == NULL) {
+    return -1;
+  }
+  riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf, NULL, NULL);
+  if (iter_h == NULL) {
+    riff_file_close(rf);
+    return -1;
+  }
+  riff_file_data_chunk_iterator_set_flags(iter_h, flags);
+  *chunks = 0;
+  *lists  = 0;
+  int32_t n;
+  while ((n = riff_file_data_chunk_iterator_next_batch(iter_h, descs, BENCH_BATCH_DESCS)) > 0) {
+    int32_t i;
+    for (i = 0; i < n; i++) {
+      *chunks += (descs[i].kind == RIFF_FILE_CHUNK_DATA);
+      *lists  += (descs[i].kind == RIFF_FILE_CHUNK_LIST_START);
+    }
+  }
+  riff_file_data_chunk_iterator_delete(iter_h);
+  *rss_kb = suite_rss_kb();
+  riff_file_close(rf);
+  return (n < 0) ? -1 : 0;
+}
+
+// measure one corpus file, run in child process so faults and peak RSS are its own
+//@return 0 on success, 1 on error
+static int suite_measure(const char *name, const char *filename, const char *type, uint32_t flags,
+                         uint64_t file_bytes)
+{
+  // first round from cold page cache gives page faults
+  uint64_t chunks, lists, rss_kb;
+  struct rusage before, after;
+  if (drop_file_cache(filename) != 0) {
+    return 1;
+  }
+  getrusage(RUSAGE_SELF, &before);
+  double start = now_sec();
+  if (suite_iterate(filename, type, flags, &chunks, &lists, &rss_kb) != 0) {
+    printf("bench suite %s failed\n", filename);
+    return 1;
+  }
+  double cold = now_sec() - start;
+  getrusage(RUSAGE_SELF, &after);
+
+  // warm rounds, best is reported
+  double best = 0;
+  int r;
+  for (r = 0; r < BENCH_SUITE_ROUNDS; r++) {
+    uint64_t rss_warm;
+    start = now_sec();
+    if (suite_iterate(filename, type, flags, &chunks, &lists, &rss_warm) != 0) {
+      return 1;
+    }
+    double elapsed = now_sec() - start;
+    if ((r == 0) || (elapsed < best)) {
+      best = elapsed;
+    }
+  }
+  struct rusage peak;
+  getrusage(RUSAGE_SELF, &peak);
+
+  printf("{\"case\":\"%s\",\"file_bytes\":%llu,\"chunks\":%llu,\"lists\":%llu,"
+         "\"rounds\":%d,\"best_s\":%.6f,\"chunks_per_s\":%.0f,\"bytes_per_s\":%.0f,"
+         "\"cold_s\":%.6f,\"minflt\":%ld,\"majflt\":%ld,\"rss_kb\":%llu,\"maxrss_kb\":%ld}\n",
+         name, (unsigned long long)file_bytes, (unsigned long long)chunks, (unsigned long long)lists,
+         BENCH_SUITE_ROUNDS, best, (chunks + lists) / best, file_bytes / best,
+         cold, after.ru_minflt - before.ru_minflt, after.ru_majflt - before.ru_majflt,
+         (unsigned long long)rss_kb, peak.ru_maxrss);
+  return 0;
+}
+
+//--------------------------------------------------
+static int bench_suite(const char *dirname)
+{
+  static const struct {
+    const char *name;
+    const char *type;
+    uint32_t flags;
+    int (*generate)(const char *filename);
+  } cases[] = {
+    { "wav_flat",   "WAVE", 0,                               generate_suite_wav_flat   },
+    { "wav_huge",   "WAVE", 0,                               generate_suite_wav_huge   },
+    { "avi_frames", "AVI ", RIFF_FILE_ITERATOR_DESCEND_MOVI, generate_suite_avi_frames },
+    { "avi_deep",   "AVI ", 0,                               generate_suite_avi_deep   },
+    { "webp_tiny",  "WEBP", 0,                               generate_suite_webp_tiny  },
+  };
+
+  if ((mkdir(dirname, 0755) != 0) && (errno != EEXIST)) {
+    perror("bench suite dir create failed");
+    return 1;
+  }
+
+  size_t c;
+  int res = 0;
+  for (c = 0; (res == 0) && (c < sizeof(cases) / sizeof(cases[0])); c++) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s/%s.riff", dirname, cases[c].name);
+    struct stat st;
+    if ((cases[c].generate(filename) != 0) || (stat(filename, &st) != 0)) {
+      return 1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      int code = suite_measure(cases[c].name, filename, cases[c].type, cases[c].flags, (uint64_t)st.st_size);
+      fflush(stdout);
+      _exit(code);
+    }
+    int status = 0;
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+      res = 1;
+    }
+    unlink(filename);
+  }
+  return res;
+}
+
+//--------------------------------------------------
+// frame sizes of write benchmark, odd sizes exercise pad bytes
+static size_t write_video_size(uint32_t frame)
+{
+  if ((frame % BENCH_WRITE_KEY_INTERVAL) == 0) {
+    return BENCH_WRITE_KEY_SIZE;
+  }
+  return 2000 + ((frame * 7919u) % 6000);
+}
+
+static int write_adhoc_all(int fd, const void *data, size_t len)
+{
+  return (write(fd, data, len) == (ssize_t)len) ? 0 : -1;
+}
+
+static int write_adhoc_chunk(int fd, const char id[4], const uint8_t *data, size_t size)
+{
+  uint8_t hdr[8];
+  uint32_t size32 = (uint32_t)size;
+  memcpy(hdr, id, 4);
+  memcpy(hdr + 4, &size32, 4);
+  if ((write_adhoc_all(fd, hdr, sizeof(hdr)) != 0) || (write_adhoc_all(fd, data, size) != 0)) {
+    return -1;
+  }
+  return ((size & 1) != 0) ? write_adhoc_all(fd, "", 1) : 0;
+}
+
+static int write_adhoc_patch(int fd, off_t hdr_offset)
+{
+  off_t end = lseek(fd, 0, SEEK_CUR);
+  uint32_t size32 = (uint32_t)(end - hdr_offset - 8);
+  return (pwrite(fd, &size32, 4, hdr_offset + 4) == 4) ? 0 : -1;
+}
+
+// ad-hoc writer as used before, one write per header, payload and pad, sizes patched with pwrite
+static int write_adhoc(const char *filename, const uint8_t *payload)
+{
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    return -1;
+  }
+  int err = write_adhoc_all(fd, "RIFF\0\0\0\0AVI LIST\0\0\0\0hdrl", 24);
+  err |= write_adhoc_chunk(fd, "avih", payload, 56);
+  err |= write_adhoc_patch(fd, 12);
+  off_t movi = lseek(fd, 0, SEEK_CUR);
+  err |= write_adhoc_all(fd, "LIST\0\0\0\0movi", 12);
+  uint32_t f;
+  for (f = 0; (f < BENCH_WRITE_FRAMES) && (err == 0); f++) {
+    err |= write_adhoc_chunk(fd, "00dc", payload, write_video_size(f));
+    err |= write_adhoc_chunk(fd, "01wb", payload, BENCH_WRITE_AUDIO_SIZE);
+  }
+  err |= write_adhoc_patch(fd, movi);
+  err |= write_adhoc_patch(fd, 0);
+  return ((close(fd) == 0) && (err == 0)) ? 0 : -1;
+}
+
+// same file with buffered writer
+static int write_buffered(const char *filename, const uint8_t *payload)
+{
+  riff_file_writer_h w = riff_file_writer_open(filename, "AVI ");
+  if (w == NULL) {
+    return -1;
+  }
+  riff_file_writer_list_begin(w, "hdrl");
+  riff_file_writer_chunk(w, "avih", payload, 56);
+  riff_file_writer_list_end(w);
+  riff_file_writer_list_begin(w, "movi");
+  uint32_t f;
+  for (f = 0; f < BENCH_WRITE_FRAMES; f++) {
+    riff_file_writer_chunk(w, "00dc", payload, write_video_size(f));
+    riff_file_writer_chunk(w, "01wb", payload, BENCH_WRITE_AUDIO_SIZE);
+  }
+  riff_file_writer_list_end(w);
+  return riff_file_writer_close(w);
+}
+
+//--------------------------------------------------
+static int bench_write(const char *filename)
+{
+  static const char *names[] = { "ad-hoc", "writer" };
+  static int (*const writers[])(const char *, const uint8_t *) = { write_adhoc, write_buffered };
+  uint8_t *payload = (uint8_t *)calloc(1, BENCH_WRITE_KEY_SIZE);
+  if (payload == NULL) {
+    return 1;
+  }
+  size_t k;
+  for (k = 0; k < sizeof(writers) / sizeof(writers[0]); k++) {
+    double best = 0.0;
+    int r;
+    for (r = 0; r < BENCH_WRITE_ROUNDS; r++) {
+      double start = now_sec();
+      if (writers[k](filename, payload) != 0) {
+        printf("write %s failed\n", names[k]);
+        free(payload);
+        return 1;
+      }
+      double elapsed = now_sec() - start;
+      if ((r == 0) || (elapsed < best)) {
+        best = elapsed;
+      }
+    }
+    // read back to check sizes and pad bytes
+    uint64_t chunks = 0, lists = 0, rss_kb;
+    struct stat st;
+    if ((suite_iterate(filename, "AVI ", RIFF_FILE_ITERATOR_DESCEND_MOVI, &chunks, &lists, &rss_kb) != 0) ||
+        (chunks != 2 * (uint64_t)BENCH_WRITE_FRAMES + 1) || (lists != 2) ||
+        (stat(filename, &st) != 0)) {
+      printf("write %s: read back failed\n", names[k]);
+      free(payload);
+      return 1;
+    }
+    printf("write %-6s: %llu chunks %llu lists, %.1f MiB in %.3f s, %.0f MiB/s\n", names[k],
+           (unsigned long long)chunks, (unsigned long long)lists, (double)st.st_size / (1024.0 * 1024.0),
+           best, (double)st.st_size / (1024.0 * 1024.0) / best);
+  }
+  free(payload);
+  return 0;
+}
+
+//--------------------------------------------------
+int main(int argc, char **argv)
+{
+  printf("RIFF file reader benchmark\n");
+
+  if ((argc > 1) && (strcmp(argv[1], "access") == 0)) {
+    return bench_access((argc > 2) ? argv[2] : BENCH_ACCESS_DEFAULT_FILENAME);
+  }
+  if ((argc > 1) && (strcmp(argv[1], "batch") == 0)) {
+    return bench_batch((argc > 2) ? argv[2] : BENCH_BATCH_DEFAULT_DIRNAME);
+  }
+  if ((argc > 1) && (strcmp(argv[1], "index") == 0)) {
+    return bench_index((argc > 2) ? argv[2] : BENCH_ACCESS_DEFAULT_FILENAME);
+  }
+  if ((argc > 1) && (strcmp(argv[1], "pcm") == 0)) {
+    return bench_pcm((argc > 2) ? argv[2] : BENCH_PCM_DEFAULT_FILENAME);
+  }
+  if ((argc > 1) && (strcmp(argv[1], "fourcc") == 0)) {
+    return bench_fourcc((argc > 2) ? argv[2] : BENCH_FOURCC_DEFAULT_FILENAME);
+  }
+  if ((argc > 1) && (strcmp(argv[1], "suite") == 0)) {
+    return bench_suite((argc > 2) ? argv[2] : BENCH_SUITE_DEFAULT_DIRNAME);
+  }
+  if ((argc > 1) && (strcmp(argv[1], "write") == 0)) {
+    return bench_write((argc > 2) ? argv[2] : BENCH_WRITE_DEFAULT_FILENAME);
+  }
+  if ((argc > 1) && (strcmp(argv[1], "rf64") == 0)) {
+    return bench_rf64((argc > 2) ? argv[2] : BENCH_RF64_DEFAULT_FILENAME);
+  }
+  if ((argc > 1) && (strcmp(argv[1], "nested") != 0)) {
+    printf("Usage: %s [nested|access|batch|index|pcm|fourcc|suite|write|rf64] [filename|dirname]\n", argv[0]);
+    return 0;
+  }
+  return bench_nested((argc > 2) ? argv[2] : BENCH_DEFAULT_FILENAME);
+}
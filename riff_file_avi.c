@@ -0,0 +1,457 @@
+/**
+ * AVI frame index decoder for RIFF file reader.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <riff_file_avi.h>
+
+//------------------------------------------------------------------
+
+// Max streams, stream number is two decimal digits in chunk id
+#define RIFF_FILE_AVI_MAX_STREAMS     (100)
+
+// idx1 entry flag for key frames
+#define RIFF_FILE_AVI_IDX1_KEYFRAME   (0x10)
+// idx1 entry: chunk id, flags, offset, size
+#define RIFF_FILE_AVI_IDX1_ENTRY_SIZE (16)
+
+// OpenDML index types
+#define RIFF_FILE_AVI_INDEX_OF_INDEXES (0x00)
+#define RIFF_FILE_AVI_INDEX_OF_CHUNKS  (0x01)
+// OpenDML index header, common to super and standard index
+#define RIFF_FILE_AVI_INDX_HEADER_SIZE (24)
+// size bit marking delta frame in standard index
+#define RIFF_FILE_AVI_INDX_DELTA_FRAME (0x80000000u)
+
+//------------------------------------------------------------------
+
+// Frame table of one stream, struct of arrays so seeking touches only what it needs
+struct riff_file_avi_stream_s
+{
+  uint64_t *offsets;
+  uint32_t *sizes;
+  uint8_t *keyframes;
+  size_t count;
+  size_t capacity;
+};
+
+// Struct describing frame index of file
+struct riff_file_avi_index_s
+{
+  struct riff_file_avi_stream_s streams[RIFF_FILE_AVI_MAX_STREAMS];
+  int32_t stream_count;
+};
+
+//------------------------------------------------------------------
+// little endian field loads from unaligned index data
+static uint16_t avi_get_u16(const uint8_t *p)
+{
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t avi_get_u32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t avi_get_u64(const uint8_t *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+//------------------------------------------------------------------
+// stream number from chunk id like "00dc" or "01wb"
+//@return -1 if id does not belong to a stream
+static int32_t avi_stream_number(const uint8_t id[4])
+{
+  if ((id[0] < '0') || (id[0] > '9') || (id[1] < '0') || (id[1] > '9')) {
+    return -1;
+  }
+  return (id[0] - '0') * 10 + (id[1] - '0');
+}
+
+//------------------------------------------------------------------
+// read payload of chunk at offset into new buffer
+//@return NULL on error
+static uint8_t* avi_read_payload(riff_file_h file_h, uint64_t offset, uint32_t size)
+{
+  // reject bogus sizes before allocating
+  if ((offset + sizeof(struct riff_file_data_subchunk_s) + size) > riff_file_get_size(file_h)) {
+    return NULL;
+  }
+  uint8_t *buf = (uint8_t *)malloc(size ? size : 1);
+  if (buf == NULL) {
+    return NULL;
+  }
+  if (riff_file_read(file_h, offset + sizeof(struct riff_file_data_subchunk_s), buf, size) != 0) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+//------------------------------------------------------------------
+static int32_t avi_stream_reserve(struct riff_file_avi_stream_s *s, size_t extra)
+{
+  size_t capacity = s->count + extra;
+  if (capacity <= s->capacity) {
+    return 0;
+  }
+  // grow geometrically, OpenDML files reserve once per ix## chunk
+  if (capacity < (s->capacity * 2)) {
+    capacity = s->capacity * 2;
+  }
+  uint64_t *offsets = (uint64_t *)realloc(s->offsets, capacity * sizeof(uint64_t));
+  if (offsets == NULL) {
+    return -1;
+  }
+  s->offsets = offsets;
+  uint32_t *sizes = (uint32_t *)realloc(s->sizes, capacity * sizeof(uint32_t));
+  if (sizes == NULL) {
+    return -1;
+  }
+  s->sizes = sizes;
+  uint8_t *keyframes = (uint8_t *)realloc(s->keyframes, capacity * sizeof(uint8_t));
+  if (keyframes == NULL) {
+    return -1;
+  }
+  s->keyframes = keyframes;
+  s->capacity  = capacity;
+  return 0;
+}
+
+//------------------------------------------------------------------
+// add frame, space must be reserved, frame outside file keeps its slot
+// with offset 0 and size 0 so later frames keep their numbers
+static void avi_stream_add(struct riff_file_avi_stream_s *s, uint64_t file_size,
+                           uint64_t offset, uint32_t size, bool keyframe)
+{
+  if ((offset > file_size) || (size > (file_size - offset))) {
+    offset   = 0;
+    size     = 0;
+    keyframe = false;
+  }
+  s->offsets[s->count]   = offset;
+  s->sizes[s->count]     = size;
+  s->keyframes[s->count] = keyframe ? 1 : 0;
+  s->count++;
+}
+
+//------------------------------------------------------------------
+// check chunk header at offset has expected id
+static bool avi_chunk_id_at(riff_file_h file_h, uint64_t offset, const uint8_t id[4])
+{
+  char hdr[4];
+  if (riff_file_read(file_h, offset, hdr, sizeof(hdr)) != 0) {
+    return false;
+  }
+  return riff_file_fourcc(hdr) == riff_file_fourcc((const char *)id);
+}
+
+//------------------------------------------------------------------
+// decode standard index (ix## chunk or indx holding chunks) into frame table of stream
+static int32_t avi_decode_std_index(struct riff_file_avi_stream_s *s, uint64_t file_size,
+                                    const uint8_t *data, uint32_t size)
+{
+  if (size < RIFF_FILE_AVI_INDX_HEADER_SIZE) {
+    return -1;
+  }
+  uint16_t longs = avi_get_u16(data);
+  uint32_t count = avi_get_u32(data + 4);
+  uint64_t base  = avi_get_u64(data + 12);
+  size_t stride  = (size_t)longs * 4;
+  // entries of field indexes carry extra offset after size
+  if ((data[3] != RIFF_FILE_AVI_INDEX_OF_CHUNKS) || (stride < 8)) {
+    return -1;
+  }
+  if (count > (size - RIFF_FILE_AVI_INDX_HEADER_SIZE) / stride) {
+    count = (uint32_t)((size - RIFF_FILE_AVI_INDX_HEADER_SIZE) / stride);
+  }
+  if (avi_stream_reserve(s, count) != 0) {
+    return -1;
+  }
+  const uint8_t *e = data + RIFF_FILE_AVI_INDX_HEADER_SIZE;
+  uint32_t i;
+  for (i = 0; i < count; i++, e += stride) {
+    uint32_t frame_size = avi_get_u32(e + 4);
+    avi_stream_add(s, file_size, base + avi_get_u32(e),
+                   frame_size & ~RIFF_FILE_AVI_INDX_DELTA_FRAME,
+                   (frame_size & RIFF_FILE_AVI_INDX_DELTA_FRAME) == 0);
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+// decode indx chunk of stream, super index entries point to ix## chunks
+static int32_t avi_decode_indx(riff_file_h file_h, struct riff_file_avi_stream_s *s,
+                               const uint8_t *data, uint32_t size)
+{
+  uint64_t file_size = riff_file_get_size(file_h);
+  if (size < RIFF_FILE_AVI_INDX_HEADER_SIZE) {
+    return -1;
+  }
+  if (data[3] == RIFF_FILE_AVI_INDEX_OF_CHUNKS) {
+    return avi_decode_std_index(s, file_size, data, size);
+  }
+  if (data[3] != RIFF_FILE_AVI_INDEX_OF_INDEXES) {
+    return -1;
+  }
+  size_t stride  = (size_t)avi_get_u16(data) * 4;
+  uint32_t count = avi_get_u32(data + 4);
+  if (stride < 16) {
+    return -1;
+  }
+  if (count > (size - RIFF_FILE_AVI_INDX_HEADER_SIZE) / stride) {
+    count = (uint32_t)((size - RIFF_FILE_AVI_INDX_HEADER_SIZE) / stride);
+  }
+  const uint8_t *e = data + RIFF_FILE_AVI_INDX_HEADER_SIZE;
+  uint32_t i;
+  for (i = 0; i < count; i++, e += stride) {
+    // size in super index entry is not reliable across writers, take it from ix## header
+    uint64_t offset = avi_get_u64(e);
+    struct riff_file_data_subchunk_s hdr;
+    if (riff_file_read(file_h, offset, &hdr, sizeof(hdr)) != 0) {
+      return -1;
+    }
+    uint8_t *ix = avi_read_payload(file_h, offset, hdr.size);
+    if (ix == NULL) {
+      return -1;
+    }
+    int32_t res = avi_decode_std_index(s, file_size, ix, hdr.size);
+    free(ix);
+    if (res != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+// decode OpenDML indexes, one indx chunk in each strl list
+//@return 1 if indexes were found, 0 if not, -1 on error
+static int32_t avi_decode_odml(riff_file_h file_h, riff_file_index_h chunks_h,
+                               struct riff_file_avi_index_s *idx)
+{
+  int32_t found = 0;
+  int32_t stream = 0;
+  int32_t n = riff_file_index_find_fourcc(chunks_h, RIFF_FILE_FOURCC_STRL);
+  for (; (n >= 0) && (stream < RIFF_FILE_AVI_MAX_STREAMS); n = riff_file_index_find_next(chunks_h, n), stream++) {
+    const struct riff_file_index_entry_s *strl = riff_file_index_get_entry(chunks_h, (size_t)n);
+    size_t count = riff_file_index_get_count(chunks_h);
+    size_t i;
+    // children of list follow it in index
+    for (i = (size_t)n + 1; i < count; i++) {
+      const struct riff_file_index_entry_s *e = riff_file_index_get_entry(chunks_h, i);
+      if (e->level <= strl->level) {
+        break;
+      }
+      if ((e->parent != n) || (riff_file_fourcc(e->id) != RIFF_FILE_FOURCC_INDX)) {
+        continue;
+      }
+      if (e->size > UINT32_MAX) {
+        return -1;
+      }
+      uint8_t *data = avi_read_payload(file_h, e->offset, (uint32_t)e->size);
+      if (data == NULL) {
+        return -1;
+      }
+      int32_t res = avi_decode_indx(file_h, &idx->streams[stream], data, (uint32_t)e->size);
+      free(data);
+      if (res != 0) {
+        return -1;
+      }
+      found = 1;
+      break;
+    }
+  }
+  if (found) {
+    idx->stream_count = stream;
+  }
+  return found;
+}
+
+//------------------------------------------------------------------
+// decode idx1 chunk, offsets are relative to movi list type or absolute
+//@return 1 if index was found, 0 if not, -1 on error
+static int32_t avi_decode_idx1(riff_file_h file_h, riff_file_index_h chunks_h,
+                               struct riff_file_avi_index_s *idx)
+{
+  int32_t n = riff_file_index_find_fourcc(chunks_h, RIFF_FILE_FOURCC_IDX1);
+  int32_t m = riff_file_index_find_fourcc(chunks_h, RIFF_FILE_FOURCC_MOVI);
+  if ((n < 0) || (m < 0)) {
+    return 0;
+  }
+  const struct riff_file_index_entry_s *e = riff_file_index_get_entry(chunks_h, (size_t)n);
+  uint64_t movi = riff_file_index_get_entry(chunks_h, (size_t)m)->offset + sizeof(struct riff_file_data_subchunk_s);
+  uint64_t file_size = riff_file_get_size(file_h);
+  if (e->size > UINT32_MAX) {
+    return -1;
+  }
+  uint8_t *data = avi_read_payload(file_h, e->offset, (uint32_t)e->size);
+  if (data == NULL) {
+    return -1;
+  }
+  size_t entries = e->size / RIFF_FILE_AVI_IDX1_ENTRY_SIZE;
+  size_t counts[RIFF_FILE_AVI_MAX_STREAMS] = { 0 };
+  uint64_t base = 0;
+  bool base_found = false;
+  const uint8_t *p;
+  size_t i;
+  // count frames per stream so tables are allocated once at exact size
+  for (i = 0, p = data; i < entries; i++, p += RIFF_FILE_AVI_IDX1_ENTRY_SIZE) {
+    int32_t stream = avi_stream_number(p);
+    if (stream < 0) {
+      continue;
+    }
+    if (!base_found) {
+      // probe first frame against both offset conventions
+      uint32_t offset = avi_get_u32(p + 8);
+      if (avi_chunk_id_at(file_h, movi + offset, p)) {
+        base = movi;
+      }
+      else if (!avi_chunk_id_at(file_h, offset, p)) {
+        free(data);
+        return -1;
+      }
+      base_found = true;
+    }
+    counts[stream]++;
+    if (stream >= idx->stream_count) {
+      idx->stream_count = stream + 1;
+    }
+  }
+  for (i = 0; i < RIFF_FILE_AVI_MAX_STREAMS; i++) {
+    if (avi_stream_reserve(&idx->streams[i], counts[i]) != 0) {
+      free(data);
+      return -1;
+    }
+  }
+  for (i = 0, p = data; i < entries; i++, p += RIFF_FILE_AVI_IDX1_ENTRY_SIZE) {
+    int32_t stream = avi_stream_number(p);
+    if (stream < 0) {
+      continue;
+    }
+    // offset points to chunk header, table holds payload
+    avi_stream_add(&idx->streams[stream], file_size,
+                   base + avi_get_u32(p + 8) + sizeof(struct riff_file_data_subchunk_s),
+                   avi_get_u32(p + 12), (avi_get_u32(p + 4) & RIFF_FILE_AVI_IDX1_KEYFRAME) != 0);
+  }
+  free(data);
+  return 1;
+}
+
+//------------------------------------------------------------------
+riff_file_avi_index_h riff_file_avi_index_new(riff_file_h file_h)
+{
+  riff_file_index_h chunks_h = riff_file_index_get(file_h);
+  if (chunks_h == NULL) {
+    return NULL;
+  }
+  struct riff_file_avi_index_s *idx = (struct riff_file_avi_index_s *)calloc(1, sizeof(struct riff_file_avi_index_s));
+  if (idx == NULL) {
+    return NULL;
+  }
+  // OpenDML indexes cover whole file, idx1 only first RIFF chunk
+  int32_t res = avi_decode_odml(file_h, chunks_h, idx);
+  if (res == 0) {
+    res = avi_decode_idx1(file_h, chunks_h, idx);
+  }
+  if (res <= 0) {
+    riff_file_avi_index_delete(idx);
+    return NULL;
+  }
+  return idx;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_avi_index_get_stream_count(riff_file_avi_index_h index_h)
+{
+  struct riff_file_avi_index_s *idx = (struct riff_file_avi_index_s *)index_h;
+  return idx->stream_count;
+}
+
+//------------------------------------------------------------------
+size_t riff_file_avi_index_get_frame_count(riff_file_avi_index_h index_h, int32_t stream)
+{
+  struct riff_file_avi_index_s *idx = (struct riff_file_avi_index_s *)index_h;
+  if ((stream < 0) || (stream >= idx->stream_count)) {
+    return 0;
+  }
+  return idx->streams[stream].count;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_avi_index_get_frame(riff_file_avi_index_h index_h, int32_t stream, size_t n,
+                                      struct riff_file_avi_frame_s *frame)
+{
+  struct riff_file_avi_index_s *idx = (struct riff_file_avi_index_s *)index_h;
+  if ((stream < 0) || (stream >= idx->stream_count) || (n >= idx->streams[stream].count)) {
+    return -1;
+  }
+  const struct riff_file_avi_stream_s *s = &idx->streams[stream];
+  frame->offset   = s->offsets[n];
+  frame->size     = s->sizes[n];
+  frame->keyframe = s->keyframes[n] != 0;
+  return 0;
+}
+
+//------------------------------------------------------------------
+const uint64_t* riff_file_avi_index_get_offsets(riff_file_avi_index_h index_h, int32_t stream)
+{
+  struct riff_file_avi_index_s *idx = (struct riff_file_avi_index_s *)index_h;
+  if ((stream < 0) || (stream >= idx->stream_count)) {
+    return NULL;
+  }
+  return idx->streams[stream].offsets;
+}
+
+//------------------------------------------------------------------
+const uint32_t* riff_file_avi_index_get_sizes(riff_file_avi_index_h index_h, int32_t stream)
+{
+  struct riff_file_avi_index_s *idx = (struct riff_file_avi_index_s *)index_h;
+  if ((stream < 0) || (stream >= idx->stream_count)) {
+    return NULL;
+  }
+  return idx->streams[stream].sizes;
+}
+
+//------------------------------------------------------------------
+const uint8_t* riff_file_avi_index_get_keyframes(riff_file_avi_index_h index_h, int32_t stream)
+{
+  struct riff_file_avi_index_s *idx = (struct riff_file_avi_index_s *)index_h;
+  if ((stream < 0) || (stream >= idx->stream_count)) {
+    return NULL;
+  }
+  return idx->streams[stream].keyframes;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_avi_index_delete(riff_file_avi_index_h index_h)
+{
+  struct riff_file_avi_index_s *idx = (struct riff_file_avi_index_s *)index_h;
+  int32_t i;
+  for (i = 0; i < RIFF_FILE_AVI_MAX_STREAMS; i++) {
+    free(idx->streams[i].offsets);
+    free(idx->streams[i].sizes);
+    free(idx->streams[i].keyframes);
+  }
+  free(idx);
+  return 0;
+}
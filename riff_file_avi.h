@@ -0,0 +1,61 @@
+#ifndef _RIFF_FILE_AVI_H_
+#define _RIFF_FILE_AVI_H_
+
+/**
+ * AVI frame index decoder for RIFF file reader.
+ * Decodes OpenDML super and standard indexes (indx/ix##) or the legacy
+ * idx1 index into per stream frame offset/size tables, so any frame can
+ * be located in constant time without walking the movi list.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <riff_file_reader.h>
+
+// frame located through index
+struct riff_file_avi_frame_s
+{
+  // file offset of frame payload, chunk header is 8 bytes before,
+  // 0 if index entry points outside file, size is 0 then too
+  uint64_t offset;
+  // payload size
+  uint32_t size;
+  bool keyframe;
+};
+
+// handle to AVI frame index
+typedef void* riff_file_avi_index_h;
+
+// decode frame index of AVI file, OpenDML indexes are used if present, otherwise idx1
+//@return NULL if file has no usable index
+riff_file_avi_index_h riff_file_avi_index_new(riff_file_h file_h);
+
+// number of streams in index
+int32_t riff_file_avi_index_get_stream_count(riff_file_avi_index_h index_h);
+
+// number of frames of stream
+size_t riff_file_avi_index_get_frame_count(riff_file_avi_index_h index_h, int32_t stream);
+
+// get frame n of stream
+//@return 0 on success, -1 if out of range
+int32_t riff_file_avi_index_get_frame(riff_file_avi_index_h index_h, int32_t stream, size_t n,
+                                      struct riff_file_avi_frame_s *frame);
+
+// per stream tables, one entry per frame, NULL if stream is out of range
+const uint64_t* riff_file_avi_index_get_offsets(riff_file_avi_index_h index_h, int32_t stream);
+const uint32_t* riff_file_avi_index_get_sizes(riff_file_avi_index_h index_h, int32_t stream);
+const uint8_t*  riff_file_avi_index_get_keyframes(riff_file_avi_index_h index_h, int32_t stream);
+
+// delete index
+int32_t riff_file_avi_index_delete(riff_file_avi_index_h index_h);
+
+#endif
@@ -0,0 +1,244 @@
+/**
+ * Batch scanning of many RIFF files on a pool of worker threads.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+// for sysconf CPU count
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <riff_file_batch.h>
+
+//------------------------------------------------------------------
+
+// Max worker threads
+#define RIFF_FILE_BATCH_MAX_THREADS (256)
+
+//------------------------------------------------------------------
+
+// Queue of files owned by one worker, owner takes from head and thieves from tail
+struct riff_file_batch_queue_s
+{
+  pthread_mutex_t lock;
+  size_t head;
+  size_t tail;
+};
+
+// Struct describing batch scan shared by all workers
+struct riff_file_batch_s
+{
+  const char *const *paths;
+  const char *type;
+  const struct riff_file_open_options_s *options;
+  riff_file_batch_result_fn_t result_cb;
+  void *user;
+  pthread_mutex_t result_lock;
+  int32_t threads;
+  struct riff_file_batch_queue_s *queues;
+};
+
+// Struct describing one worker
+struct riff_file_batch_worker_s
+{
+  struct riff_file_batch_s *batch;
+  int32_t id;
+  pthread_t thread;
+};
+
+//------------------------------------------------------------------
+// pass error to log callback, batch has no handle to keep it on
+__attribute__((cold, noinline))
+static void batch_report(enum riff_file_error_e error, int sys_errno)
+{
+  struct riff_file_diag_s d;
+  memset(&d, 0, sizeof(d));
+  d.error     = error;
+  d.sys_errno = sys_errno;
+  riff_file_log(&d);
+}
+
+//------------------------------------------------------------------
+static bool queue_pop_head(struct riff_file_batch_queue_s *q, size_t *item)
+{
+  bool found = false;
+  pthread_mutex_lock(&q->lock);
+  if (q->head < q->tail) {
+    *item = q->head++;
+    found = true;
+  }
+  pthread_mutex_unlock(&q->lock);
+  return found;
+}
+
+//------------------------------------------------------------------
+static bool queue_pop_tail(struct riff_file_batch_queue_s *q, size_t *item)
+{
+  bool found = false;
+  pthread_mutex_lock(&q->lock);
+  if (q->head < q->tail) {
+    *item = --q->tail;
+    found = true;
+  }
+  pthread_mutex_unlock(&q->lock);
+  return found;
+}
+
+//------------------------------------------------------------------
+// take next file from own queue, or steal from other workers when empty
+static bool batch_next(struct riff_file_batch_s *b, int32_t id, size_t *item)
+{
+  if (queue_pop_head(&b->queues[id], item)) {
+    return true;
+  }
+  int32_t i;
+  for (i = 1; i < b->threads; i++) {
+    int32_t victim = (id + i) % b->threads;
+    if (queue_pop_tail(&b->queues[victim], item)) {
+      return true;
+    }
+  }
+  // no file is ever added, so all queues stay empty from now on
+  return false;
+}
+
+//------------------------------------------------------------------
+static void batch_scan_file(struct riff_file_batch_s *b, size_t item)
+{
+  struct riff_file_batch_result_s r;
+  memset(&r, 0, sizeof(r));
+  r.index  = item;
+  r.path   = b->paths[item];
+  r.status = -1;
+
+  riff_file_h rf = riff_file_open_ex(r.path, b->type, b->options);
+  if (rf == NULL) {
+    r.error = riff_file_get_open_error(NULL);
+  }
+  else {
+    riff_file_get_format(rf, r.format);
+    r.file_size = riff_file_get_size(rf);
+    riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf, NULL, NULL);
+    if (iter_h != NULL) {
+      struct riff_file_chunk_desc_s desc;
+      int32_t res;
+      while ((res = riff_file_data_chunk_iterator_next_desc(iter_h, &desc)) > 0) {
+        r.chunk_count++;
+        r.payload_bytes += desc.size;
+        if (desc.level > r.max_level) {
+          r.max_level = desc.level;
+        }
+      }
+      if (res == 0) {
+        r.status = 0;
+      }
+      r.error = riff_file_data_chunk_iterator_get_error(iter_h, NULL);
+      riff_file_data_chunk_iterator_delete(iter_h);
+    }
+    else {
+      r.error = riff_file_get_error(rf, NULL);
+    }
+    riff_file_close(rf);
+  }
+
+  if (b->result_cb != NULL) {
+    pthread_mutex_lock(&b->result_lock);
+    b->result_cb(&r, b->user);
+    pthread_mutex_unlock(&b->result_lock);
+  }
+}
+
+//------------------------------------------------------------------
+static void* batch_worker(void *arg)
+{
+  struct riff_file_batch_worker_s *w = (struct riff_file_batch_worker_s *)arg;
+  size_t item;
+  while (batch_next(w->batch, w->id, &item)) {
+    batch_scan_file(w->batch, item);
+  }
+  return NULL;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_batch_scan(const char *const *paths, size_t count, const char type[4],
+                             int32_t threads, const struct riff_file_open_options_s *options,
+                             riff_file_batch_result_fn_t result_cb, void *user)
+{
+  if (threads <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (cpus > 0) ? (int32_t)cpus : 1;
+  }
+  if (threads > RIFF_FILE_BATCH_MAX_THREADS) {
+    threads = RIFF_FILE_BATCH_MAX_THREADS;
+  }
+  if ((size_t)threads > count) {
+    threads = (count > 0) ? (int32_t)count : 1;
+  }
+
+  struct riff_file_batch_s b;
+  b.paths     = paths;
+  b.type      = type;
+  b.options   = options;
+  b.result_cb = result_cb;
+  b.user      = user;
+  b.threads   = threads;
+  b.queues    = (struct riff_file_batch_queue_s *)malloc(threads * sizeof(struct riff_file_batch_queue_s));
+  struct riff_file_batch_worker_s *workers =
+    (struct riff_file_batch_worker_s *)malloc(threads * sizeof(struct riff_file_batch_worker_s));
+  if ((b.queues == NULL) || (workers == NULL)) {
+    batch_report(RIFF_FILE_ERROR_NO_MEMORY, errno);
+    free(b.queues);
+    free(workers);
+    return -1;
+  }
+  pthread_mutex_init(&b.result_lock, NULL);
+
+  // split files in contiguous ranges, one per worker
+  int32_t i;
+  for (i = 0; i < threads; i++) {
+    pthread_mutex_init(&b.queues[i].lock, NULL);
+    b.queues[i].head = (count * i) / threads;
+    b.queues[i].tail = (count * (i + 1)) / threads;
+  }
+
+  // current thread works as worker 0
+  int32_t started = 1;
+  for (i = 1; i < threads; i++) {
+    workers[i].batch = &b;
+    workers[i].id    = i;
+    int res = pthread_create(&workers[i].thread, NULL, batch_worker, &workers[i]);
+    if (res != 0) {
+      batch_report(RIFF_FILE_ERROR_THREAD, res);
+      break;
+    }
+    started++;
+  }
+  workers[0].batch = &b;
+  workers[0].id    = 0;
+  batch_worker(&workers[0]);
+
+  for (i = 1; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  for (i = 0; i < threads; i++) {
+    pthread_mutex_destroy(&b.queues[i].lock);
+  }
+  pthread_mutex_destroy(&b.result_lock);
+  free(b.queues);
+  free(workers);
+  return 0;
+}
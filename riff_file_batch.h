@@ -0,0 +1,55 @@
+#ifndef _RIFF_FILE_BATCH_H_
+#define _RIFF_FILE_BATCH_H_
+
+/**
+ * Batch scanning of many RIFF files on a pool of worker threads.
+ * Files are spread over per worker queues, idle workers steal files
+ * from other workers' queues.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <riff_file_reader.h>
+
+// result of scanning one file
+struct riff_file_batch_result_s
+{
+  // position of file in path list, and its path
+  size_t index;
+  const char *path;
+  // 0 on success, -1 if file could not be opened or iterated
+  int32_t status;
+  // why file failed, or last diagnostic of a successful scan, e.g. LIST underflow,
+  // RIFF_FILE_ERROR_NONE if file was clean
+  enum riff_file_error_e error;
+  // form type from file header
+  char format[4];
+  uint64_t file_size;
+  // number of data chunks and sum of their payload sizes
+  uint64_t chunk_count;
+  uint64_t payload_bytes;
+  // deepest list level a data chunk was found in
+  int32_t max_level;
+};
+
+// callback for each scanned file, calls are serialized but come from worker threads
+typedef void (*riff_file_batch_result_fn_t)(const struct riff_file_batch_result_s *result, void *user);
+
+// scan files on a pool of threads, 0 threads uses one thread per online CPU
+// NULL type accepts any form type, NULL options uses default open options
+// if a worker thread can not be started RIFF_FILE_ERROR_THREAD is logged and
+// files are scanned by the threads already running, calling thread included
+//@return 0 when all files are done, -1 if worker state could not be allocated
+int32_t riff_file_batch_scan(const char *const *paths, size_t count, const char type[4],
+                             int32_t threads, const struct riff_file_open_options_s *options,
+                             riff_file_batch_result_fn_t result_cb, void *user);
+
+#endif
@@ -0,0 +1,657 @@
+/**
+ * PCM sample conversion for RIFF file reader.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RIFF_FILE_PCM_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON)
+#define RIFF_FILE_PCM_NEON
+#include <arm_neon.h>
+#endif
+
+#include <riff_file_pcm.h>
+
+//------------------------------------------------------------------
+
+// Scale factors between integer samples and float
+#define RIFF_FILE_PCM_S8_SCALE    (1.0f / 128.0f)
+#define RIFF_FILE_PCM_S16_SCALE   (1.0f / 32768.0f)
+#define RIFF_FILE_PCM_S32_SCALE   (1.0f / 2147483648.0f)
+
+// Largest float below 1.0, keeps scaled value inside integer range
+#define RIFF_FILE_PCM_FLOAT_MAX   (0.99999994f)
+
+// Samples converted per block when deinterleaving through temporary buffer
+#define RIFF_FILE_PCM_BLOCK_SAMPLES (1024)
+
+//------------------------------------------------------------------
+
+// Conversion kernels of one instruction set, count is in samples
+struct riff_file_pcm_kernels_s
+{
+  enum riff_file_pcm_isa_e isa;
+  void (*s16_to_f32)(float *dst, const uint8_t *src, size_t count);
+  void (*s24_to_f32)(float *dst, const uint8_t *src, size_t count);
+  void (*s32_to_f32)(float *dst, const uint8_t *src, size_t count);
+  void (*f32_to_s16)(uint8_t *dst, const float *src, size_t count);
+  void (*f32_to_s32)(uint8_t *dst, const float *src, size_t count);
+  // split stereo frames into two planes
+  void (*deinterleave2)(float *left, float *right, const uint8_t *src, size_t frames);
+};
+
+//------------------------------------------------------------------
+// scalar kernels, also used for tails of vector kernels
+
+// NaN clamps to -1.0, same as vector max
+static float pcm_clamp(float x)
+{
+  if (!(x >= -1.0f)) {
+    return -1.0f;
+  }
+  if (x > RIFF_FILE_PCM_FLOAT_MAX) {
+    return RIFF_FILE_PCM_FLOAT_MAX;
+  }
+  return x;
+}
+
+// round half away from zero, same as vector kernels
+static int32_t pcm_round(float x)
+{
+  return (int32_t)(x + ((x < 0.0f) ? -0.5f : 0.5f));
+}
+
+static void pcm_s16_to_f32_scalar(float *dst, const uint8_t *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; i++) {
+    int16_t v;
+    memcpy(&v, src + i * 2, sizeof(v));
+    dst[i] = (float)v * RIFF_FILE_PCM_S16_SCALE;
+  }
+}
+
+static void pcm_s24_to_f32_scalar(float *dst, const uint8_t *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; i++) {
+    const uint8_t *p = src + i * 3;
+    // sample placed in top bytes of 32 bit word, scaled as 32 bit
+    uint32_t v = ((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24);
+    dst[i] = (float)(int32_t)v * RIFF_FILE_PCM_S32_SCALE;
+  }
+}
+
+static void pcm_s32_to_f32_scalar(float *dst, const uint8_t *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; i++) {
+    int32_t v;
+    memcpy(&v, src + i * 4, sizeof(v));
+    dst[i] = (float)v * RIFF_FILE_PCM_S32_SCALE;
+  }
+}
+
+static void pcm_f32_to_s16_scalar(uint8_t *dst, const float *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; i++) {
+    // largest input rounds up to 32768, saturate like vector pack
+    int32_t r = pcm_round(pcm_clamp(src[i]) * 32768.0f);
+    int16_t v = (int16_t)((r > 32767) ? 32767 : r);
+    memcpy(dst + i * 2, &v, sizeof(v));
+  }
+}
+
+static void pcm_f32_to_s32_scalar(uint8_t *dst, const float *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; i++) {
+    int32_t v = pcm_round(pcm_clamp(src[i]) * 2147483648.0f);
+    memcpy(dst + i * 4, &v, sizeof(v));
+  }
+}
+
+static void pcm_deinterleave2_scalar(float *left, float *right, const uint8_t *src, size_t frames)
+{
+  size_t i;
+  for (i = 0; i < frames; i++) {
+    memcpy(&left[i],  src + i * 8,     sizeof(float));
+    memcpy(&right[i], src + i * 8 + 4, sizeof(float));
+  }
+}
+
+static const struct riff_file_pcm_kernels_s pcm_kernels_scalar = {
+  RIFF_FILE_PCM_ISA_SCALAR,
+  pcm_s16_to_f32_scalar,
+  pcm_s24_to_f32_scalar,
+  pcm_s32_to_f32_scalar,
+  pcm_f32_to_s16_scalar,
+  pcm_f32_to_s32_scalar,
+  pcm_deinterleave2_scalar,
+};
+
+#ifdef RIFF_FILE_PCM_X86
+//------------------------------------------------------------------
+// SSE2 kernels
+
+__attribute__((target("sse2")))
+static __m128 pcm_scale_round_sse2(__m128 x, float scale)
+{
+  // clamp, scale and round half away from zero before truncating convert
+  x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(RIFF_FILE_PCM_FLOAT_MAX));
+  x = _mm_mul_ps(x, _mm_set1_ps(scale));
+  __m128 half = _mm_or_ps(_mm_and_ps(x, _mm_set1_ps(-0.0f)), _mm_set1_ps(0.5f));
+  return _mm_add_ps(x, half);
+}
+
+__attribute__((target("sse2")))
+static void pcm_s16_to_f32_sse2(float *dst, const uint8_t *src, size_t count)
+{
+  const __m128 scale = _mm_set1_ps(RIFF_FILE_PCM_S16_SCALE);
+  size_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    __m128i v  = _mm_loadu_si128((const __m128i *)(src + i * 2));
+    // sign extend by placing samples in top half and shifting down
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(dst + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  pcm_s16_to_f32_scalar(dst + i, src + i * 2, count - i);
+}
+
+__attribute__((target("sse2")))
+static void pcm_s32_to_f32_sse2(float *dst, const uint8_t *src, size_t count)
+{
+  const __m128 scale = _mm_set1_ps(RIFF_FILE_PCM_S32_SCALE);
+  size_t i = 0;
+  for (; (i + 4) <= count; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+  }
+  pcm_s32_to_f32_scalar(dst + i, src + i * 4, count - i);
+}
+
+__attribute__((target("sse2")))
+static void pcm_f32_to_s16_sse2(uint8_t *dst, const float *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    __m128i lo = _mm_cvttps_epi32(pcm_scale_round_sse2(_mm_loadu_ps(src + i), 32768.0f));
+    __m128i hi = _mm_cvttps_epi32(pcm_scale_round_sse2(_mm_loadu_ps(src + i + 4), 32768.0f));
+    _mm_storeu_si128((__m128i *)(dst + i * 2), _mm_packs_epi32(lo, hi));
+  }
+  pcm_f32_to_s16_scalar(dst + i * 2, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void pcm_f32_to_s32_sse2(uint8_t *dst, const float *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 4) <= count; i += 4) {
+    __m128i v = _mm_cvttps_epi32(pcm_scale_round_sse2(_mm_loadu_ps(src + i), 2147483648.0f));
+    _mm_storeu_si128((__m128i *)(dst + i * 4), v);
+  }
+  pcm_f32_to_s32_scalar(dst + i * 4, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void pcm_deinterleave2_sse2(float *left, float *right, const uint8_t *src, size_t frames)
+{
+  size_t i = 0;
+  for (; (i + 4) <= frames; i += 4) {
+    __m128 a = _mm_loadu_ps((const float *)(src + i * 8));
+    __m128 b = _mm_loadu_ps((const float *)(src + i * 8 + 16));
+    _mm_storeu_ps(left + i,  _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  pcm_deinterleave2_scalar(left + i, right + i, src + i * 8, frames - i);
+}
+
+// no byte shuffle in SSE2, packed 24 bit samples stay scalar
+static const struct riff_file_pcm_kernels_s pcm_kernels_sse2 = {
+  RIFF_FILE_PCM_ISA_SSE2,
+  pcm_s16_to_f32_sse2,
+  pcm_s24_to_f32_scalar,
+  pcm_s32_to_f32_sse2,
+  pcm_f32_to_s16_sse2,
+  pcm_f32_to_s32_sse2,
+  pcm_deinterleave2_sse2,
+};
+
+//------------------------------------------------------------------
+// AVX2 kernels
+
+__attribute__((target("avx2")))
+static __m256 pcm_scale_round_avx2(__m256 x, float scale)
+{
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(RIFF_FILE_PCM_FLOAT_MAX));
+  x = _mm256_mul_ps(x, _mm256_set1_ps(scale));
+  __m256 half = _mm256_or_ps(_mm256_and_ps(x, _mm256_set1_ps(-0.0f)), _mm256_set1_ps(0.5f));
+  return _mm256_add_ps(x, half);
+}
+
+__attribute__((target("avx2")))
+static void pcm_s16_to_f32_avx2(float *dst, const uint8_t *src, size_t count)
+{
+  const __m256 scale = _mm256_set1_ps(RIFF_FILE_PCM_S16_SCALE);
+  size_t i = 0;
+  for (; (i + 16) <= count; i += 16) {
+    __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i * 2)));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i * 2 + 16)));
+    _mm256_storeu_ps(dst + i,     _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+    _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+  }
+  pcm_s16_to_f32_scalar(dst + i, src + i * 2, count - i);
+}
+
+__attribute__((target("avx2")))
+static void pcm_s24_to_f32_avx2(float *dst, const uint8_t *src, size_t count)
+{
+  const __m256 scale = _mm256_set1_ps(RIFF_FILE_PCM_S32_SCALE);
+  // move each 3 byte sample to top of its 32 bit lane, low byte zeroed
+  const __m256i shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                           -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+  size_t i = 0;
+  // each step loads 28 bytes for 24 bytes of samples, stop early so last load stays in source
+  for (; (i + 10) <= count; i += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(src + i * 3));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(src + i * 3 + 12));
+    __m256i v  = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    v = _mm256_shuffle_epi8(v, shuffle);
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+  }
+  pcm_s24_to_f32_scalar(dst + i, src + i * 3, count - i);
+}
+
+__attribute__((target("avx2")))
+static void pcm_s32_to_f32_avx2(float *dst, const uint8_t *src, size_t count)
+{
+  const __m256 scale = _mm256_set1_ps(RIFF_FILE_PCM_S32_SCALE);
+  size_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+  }
+  pcm_s32_to_f32_scalar(dst + i, src + i * 4, count - i);
+}
+
+__attribute__((target("avx2")))
+static void pcm_f32_to_s16_avx2(uint8_t *dst, const float *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    __m256i v = _mm256_cvttps_epi32(pcm_scale_round_avx2(_mm256_loadu_ps(src + i), 32768.0f));
+    // pack across lanes, values are already clamped
+    __m128i s = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128((__m128i *)(dst + i * 2), s);
+  }
+  pcm_f32_to_s16_scalar(dst + i * 2, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void pcm_f32_to_s32_avx2(uint8_t *dst, const float *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    __m256i v = _mm256_cvttps_epi32(pcm_scale_round_avx2(_mm256_loadu_ps(src + i), 2147483648.0f));
+    _mm256_storeu_si256((__m256i *)(dst + i * 4), v);
+  }
+  pcm_f32_to_s32_scalar(dst + i * 4, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void pcm_deinterleave2_avx2(float *left, float *right, const uint8_t *src, size_t frames)
+{
+  size_t i = 0;
+  for (; (i + 8) <= frames; i += 8) {
+    __m256 a = _mm256_loadu_ps((const float *)(src + i * 8));
+    __m256 b = _mm256_loadu_ps((const float *)(src + i * 8 + 32));
+    // shuffle works per 128 bit lane, fix order of 64 bit pairs afterwards
+    __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    l = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0)));
+    r = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_ps(left + i,  l);
+    _mm256_storeu_ps(right + i, r);
+  }
+  pcm_deinterleave2_scalar(left + i, right + i, src + i * 8, frames - i);
+}
+
+static const struct riff_file_pcm_kernels_s pcm_kernels_avx2 = {
+  RIFF_FILE_PCM_ISA_AVX2,
+  pcm_s16_to_f32_avx2,
+  pcm_s24_to_f32_avx2,
+  pcm_s32_to_f32_avx2,
+  pcm_f32_to_s16_avx2,
+  pcm_f32_to_s32_avx2,
+  pcm_deinterleave2_avx2,
+};
+#endif
+
+#ifdef RIFF_FILE_PCM_NEON
+//------------------------------------------------------------------
+// NEON kernels
+
+static float32x4_t pcm_scale_round_neon(float32x4_t x, float scale)
+{
+  x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-1.0f)), vdupq_n_f32(RIFF_FILE_PCM_FLOAT_MAX));
+  x = vmulq_n_f32(x, scale);
+  // copy sign of value to 0.5
+  uint32x4_t sign = vdupq_n_u32(0x80000000u);
+  float32x4_t half = vbslq_f32(sign, x, vdupq_n_f32(0.5f));
+  return vaddq_f32(x, half);
+}
+
+static void pcm_s16_to_f32_neon(float *dst, const uint8_t *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    int16x8_t v = vreinterpretq_s16_u8(vld1q_u8(src + i * 2));
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+    float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+    vst1q_f32(dst + i,     vmulq_n_f32(lo, RIFF_FILE_PCM_S16_SCALE));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(hi, RIFF_FILE_PCM_S16_SCALE));
+  }
+  pcm_s16_to_f32_scalar(dst + i, src + i * 2, count - i);
+}
+
+static void pcm_s24_to_f32_neon(float *dst, const uint8_t *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    // split bytes of 8 samples into 3 planes
+    uint8x8x3_t b = vld3_u8(src + i * 3);
+    uint16x8_t lo = vshll_n_u8(b.val[0], 8);
+    uint16x8_t hi = vorrq_u16(vmovl_u8(b.val[1]), vshll_n_u8(b.val[2], 8));
+    uint32x4_t v0 = vorrq_u32(vshll_n_u16(vget_low_u16(hi), 16),  vmovl_u16(vget_low_u16(lo)));
+    uint32x4_t v1 = vorrq_u32(vshll_n_u16(vget_high_u16(hi), 16), vmovl_u16(vget_high_u16(lo)));
+    vst1q_f32(dst + i,     vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(v0)), RIFF_FILE_PCM_S32_SCALE));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(v1)), RIFF_FILE_PCM_S32_SCALE));
+  }
+  pcm_s24_to_f32_scalar(dst + i, src + i * 3, count - i);
+}
+
+static void pcm_s32_to_f32_neon(float *dst, const uint8_t *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 4) <= count; i += 4) {
+    int32x4_t v = vreinterpretq_s32_u8(vld1q_u8(src + i * 4));
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(v), RIFF_FILE_PCM_S32_SCALE));
+  }
+  pcm_s32_to_f32_scalar(dst + i, src + i * 4, count - i);
+}
+
+static void pcm_f32_to_s16_neon(uint8_t *dst, const float *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 8) <= count; i += 8) {
+    int32x4_t lo = vcvtq_s32_f32(pcm_scale_round_neon(vld1q_f32(src + i), 32768.0f));
+    int32x4_t hi = vcvtq_s32_f32(pcm_scale_round_neon(vld1q_f32(src + i + 4), 32768.0f));
+    int16x8_t v  = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+    vst1q_u8(dst + i * 2, vreinterpretq_u8_s16(v));
+  }
+  pcm_f32_to_s16_scalar(dst + i * 2, src + i, count - i);
+}
+
+static void pcm_f32_to_s32_neon(uint8_t *dst, const float *src, size_t count)
+{
+  size_t i = 0;
+  for (; (i + 4) <= count; i += 4) {
+    int32x4_t v = vcvtq_s32_f32(pcm_scale_round_neon(vld1q_f32(src + i), 2147483648.0f));
+    vst1q_u8(dst + i * 4, vreinterpretq_u8_s32(v));
+  }
+  pcm_f32_to_s32_scalar(dst + i * 4, src + i, count - i);
+}
+
+static void pcm_deinterleave2_neon(float *left, float *right, const uint8_t *src, size_t frames)
+{
+  size_t i = 0;
+  for (; (i + 4) <= frames; i += 4) {
+    float32x4x2_t v = vld2q_f32((const float *)(src + i * 8));
+    vst1q_f32(left + i,  v.val[0]);
+    vst1q_f32(right + i, v.val[1]);
+  }
+  pcm_deinterleave2_scalar(left + i, right + i, src + i * 8, frames - i);
+}
+
+static const struct riff_file_pcm_kernels_s pcm_kernels_neon = {
+  RIFF_FILE_PCM_ISA_NEON,
+  pcm_s16_to_f32_neon,
+  pcm_s24_to_f32_neon,
+  pcm_s32_to_f32_neon,
+  pcm_f32_to_s16_neon,
+  pcm_f32_to_s32_neon,
+  pcm_deinterleave2_neon,
+};
+#endif
+
+//------------------------------------------------------------------
+// dispatch
+
+static pthread_once_t pcm_kernels_once = PTHREAD_ONCE_INIT;
+// kernels in use, replaced by riff_file_pcm_set_isa while other threads may convert,
+// so always accessed atomically
+static const struct riff_file_pcm_kernels_s *pcm_kernels = &pcm_kernels_scalar;
+
+//------------------------------------------------------------------
+static const struct riff_file_pcm_kernels_s* pcm_kernels_for_isa(enum riff_file_pcm_isa_e isa)
+{
+  switch (isa) {
+  case RIFF_FILE_PCM_ISA_SCALAR:
+    return &pcm_kernels_scalar;
+#ifdef RIFF_FILE_PCM_X86
+  case RIFF_FILE_PCM_ISA_SSE2:
+    return __builtin_cpu_supports("sse2") ? &pcm_kernels_sse2 : NULL;
+  case RIFF_FILE_PCM_ISA_AVX2:
+    return __builtin_cpu_supports("avx2") ? &pcm_kernels_avx2 : NULL;
+#endif
+#ifdef RIFF_FILE_PCM_NEON
+  case RIFF_FILE_PCM_ISA_NEON:
+    return &pcm_kernels_neon;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+//------------------------------------------------------------------
+// pick best instruction set of this CPU
+static void pcm_kernels_init(void)
+{
+  static const enum riff_file_pcm_isa_e preferred[] = {
+    RIFF_FILE_PCM_ISA_AVX2, RIFF_FILE_PCM_ISA_NEON, RIFF_FILE_PCM_ISA_SSE2,
+  };
+  size_t i;
+#ifdef RIFF_FILE_PCM_X86
+  __builtin_cpu_init();
+#endif
+  for (i = 0; i < sizeof(preferred) / sizeof(preferred[0]); i++) {
+    const struct riff_file_pcm_kernels_s *k = pcm_kernels_for_isa(preferred[i]);
+    if (k != NULL) {
+      __atomic_store_n(&pcm_kernels, k, __ATOMIC_RELEASE);
+      return;
+    }
+  }
+}
+
+//------------------------------------------------------------------
+static const struct riff_file_pcm_kernels_s* pcm_get_kernels(void)
+{
+  pthread_once(&pcm_kernels_once, pcm_kernels_init);
+  return __atomic_load_n(&pcm_kernels, __ATOMIC_ACQUIRE);
+}
+
+//------------------------------------------------------------------
+static size_t pcm_sample_size(enum riff_file_wav_sample_type_e type)
+{
+  switch (type) {
+  case RIFF_FILE_WAV_SAMPLE_UINT8:   return 1;
+  case RIFF_FILE_WAV_SAMPLE_INT16:   return 2;
+  case RIFF_FILE_WAV_SAMPLE_INT24:   return 3;
+  case RIFF_FILE_WAV_SAMPLE_INT32:   return 4;
+  case RIFF_FILE_WAV_SAMPLE_FLOAT32: return 4;
+  case RIFF_FILE_WAV_SAMPLE_FLOAT64: return 8;
+  default:                           return 0;
+  }
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_pcm_to_float(float *dst, const void *src,
+                               enum riff_file_wav_sample_type_e type, size_t count)
+{
+  const struct riff_file_pcm_kernels_s *k = pcm_get_kernels();
+  const uint8_t *p = (const uint8_t *)src;
+  size_t i;
+  switch (type) {
+  case RIFF_FILE_WAV_SAMPLE_UINT8:
+    for (i = 0; i < count; i++) {
+      dst[i] = (float)((int32_t)p[i] - 128) * RIFF_FILE_PCM_S8_SCALE;
+    }
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_INT16:
+    k->s16_to_f32(dst, p, count);
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_INT24:
+    k->s24_to_f32(dst, p, count);
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_INT32:
+    k->s32_to_f32(dst, p, count);
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_FLOAT32:
+    memcpy(dst, p, count * sizeof(float));
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_FLOAT64:
+    for (i = 0; i < count; i++) {
+      double v;
+      memcpy(&v, p + i * sizeof(double), sizeof(double));
+      dst[i] = (float)v;
+    }
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_pcm_from_float(void *dst, const float *src,
+                                 enum riff_file_wav_sample_type_e type, size_t count)
+{
+  const struct riff_file_pcm_kernels_s *k = pcm_get_kernels();
+  uint8_t *p = (uint8_t *)dst;
+  size_t i;
+  switch (type) {
+  case RIFF_FILE_WAV_SAMPLE_UINT8:
+    for (i = 0; i < count; i++) {
+      int32_t v = pcm_round(pcm_clamp(src[i]) * 128.0f) + 128;
+      p[i] = (uint8_t)((v > 255) ? 255 : v);
+    }
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_INT16:
+    k->f32_to_s16(p, src, count);
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_INT24:
+    for (i = 0; i < count; i++) {
+      int32_t v = pcm_round(pcm_clamp(src[i]) * 8388608.0f);
+      if (v > 8388607) {
+        v = 8388607;
+      }
+      p[i * 3]     = (uint8_t)v;
+      p[i * 3 + 1] = (uint8_t)(v >> 8);
+      p[i * 3 + 2] = (uint8_t)(v >> 16);
+    }
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_INT32:
+    k->f32_to_s32(p, src, count);
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_FLOAT32:
+    memcpy(p, src, count * sizeof(float));
+    return 0;
+  case RIFF_FILE_WAV_SAMPLE_FLOAT64:
+    for (i = 0; i < count; i++) {
+      double v = src[i];
+      memcpy(p + i * sizeof(double), &v, sizeof(double));
+    }
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_pcm_to_float_planar(float *const *dst, const void *src,
+                                      enum riff_file_wav_sample_type_e type,
+                                      uint16_t channels, size_t frames)
+{
+  const struct riff_file_pcm_kernels_s *k = pcm_get_kernels();
+  const uint8_t *p = (const uint8_t *)src;
+  size_t sample_size = pcm_sample_size(type);
+  if ((sample_size == 0) || (channels == 0)) {
+    return -1;
+  }
+  if (channels == 1) {
+    return riff_file_pcm_to_float(dst[0], src, type, frames);
+  }
+  if ((channels == 2) && (type == RIFF_FILE_WAV_SAMPLE_FLOAT32)) {
+    k->deinterleave2(dst[0], dst[1], p, frames);
+    return 0;
+  }
+  // convert blocks of interleaved samples, then scatter to planes
+  float tmp[RIFF_FILE_PCM_BLOCK_SAMPLES];
+  size_t total = frames * channels;
+  size_t done = 0;
+  while (done < total) {
+    size_t n = total - done;
+    if (n > RIFF_FILE_PCM_BLOCK_SAMPLES) {
+      n = RIFF_FILE_PCM_BLOCK_SAMPLES;
+    }
+    riff_file_pcm_to_float(tmp, p + done * sample_size, type, n);
+    if (channels == 2) {
+      // block holds whole frames since block size is even
+      k->deinterleave2(dst[0] + done / 2, dst[1] + done / 2, (const uint8_t *)tmp, n / 2);
+    }
+    else {
+      size_t i;
+      for (i = 0; i < n; i++) {
+        size_t s = done + i;
+        dst[s % channels][s / channels] = tmp[i];
+      }
+    }
+    done += n;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+enum riff_file_pcm_isa_e riff_file_pcm_get_isa(void)
+{
+  return pcm_get_kernels()->isa;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_pcm_set_isa(enum riff_file_pcm_isa_e isa)
+{
+  pcm_get_kernels();
+  const struct riff_file_pcm_kernels_s *k = pcm_kernels_for_isa(isa);
+  if (k == NULL) {
+    return -1;
+  }
+  __atomic_store_n(&pcm_kernels, k, __ATOMIC_RELEASE);
+  return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef _RIFF_FILE_PCM_H_
+#define _RIFF_FILE_PCM_H_
+
+/**
+ * PCM sample conversion for RIFF file reader.
+ * Converts integer and float samples, e.g. straight from mapped WAV data
+ * chunk, to and from float in -1.0 to 1.0 range, interleaved or planar.
+ * Kernels use SSE2/AVX2 or NEON where available, selected at runtime.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <riff_file_wav.h>
+
+// instruction set used by conversion kernels
+enum riff_file_pcm_isa_e
+{
+  RIFF_FILE_PCM_ISA_SCALAR = 0,
+  RIFF_FILE_PCM_ISA_SSE2,
+  RIFF_FILE_PCM_ISA_AVX2,
+  RIFF_FILE_PCM_ISA_NEON,
+};
+
+// convert samples to float, source needs no alignment
+//@return 0 on success, -1 if sample type is not supported
+int32_t riff_file_pcm_to_float(float *dst, const void *src,
+                               enum riff_file_wav_sample_type_e type, size_t count);
+
+// convert float samples, clamped to -1.0 to 1.0 and rounded, destination needs no alignment
+//@return 0 on success, -1 if sample type is not supported
+int32_t riff_file_pcm_from_float(void *dst, const float *src,
+                                 enum riff_file_wav_sample_type_e type, size_t count);
+
+// convert interleaved frames to float, one destination plane per channel
+//@return 0 on success, -1 if sample type is not supported
+int32_t riff_file_pcm_to_float_planar(float *const *dst, const void *src,
+                                      enum riff_file_wav_sample_type_e type,
+                                      uint16_t channels, size_t frames);
+
+// get instruction set selected for this CPU
+enum riff_file_pcm_isa_e riff_file_pcm_get_isa(void);
+
+// force instruction set, e.g. scalar for comparison, affects all threads,
+// safe while other threads convert, each conversion call runs on one instruction set
+//@return 0 on success, -1 if not supported by this CPU or build
+int32_t riff_file_pcm_set_isa(enum riff_file_pcm_isa_e isa);
+
+#endif
@@ -15,272 +15,2410 @@
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
  */
 
+// for madvise and MAP_POPULATE
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
-#include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include <riff_file_reader.h>
+#include <riff_file_uring.h>
 
 //------------------------------------------------------------------
 
-// File and chunk header magic ID
-#define RIFF_FILE_TYPE_FILE_MAGIC     "RIFF"
+// LIST chunk id, written to descriptors of list start and end,
+// other chunk ids are compared as RIFF_FILE_FOURCC integers
 #define RIFF_FILE_TYPE_LIST_MAGIC     "LIST"
-#define RIFF_FILE_TYPE_INFO_MAGIC     "INFO"
-// (just for testing, added AVI movi ID)
-#define RIFF_FILE_TYPE_AVI_MOVI_MAGIC "movi"
 
-// Max allowed nested LIST chunks
-#define RIFF_FILE_NESTED_LIST_MAX_LEVELS (10)
+// Nested LIST levels kept inline in nesting state, deeper lists spill to heap stack
+#define RIFF_FILE_NESTING_INLINE_LEVELS (16)
+// Max nested LIST levels, bounds heap stack for hostile files
+#define RIFF_FILE_NESTED_LIST_MAX_LEVELS (1 << 20)
+// Freed heap stacks kept for reuse by later iterators and stream parsers
+#define RIFF_FILE_NESTING_POOL_SIZE (8)
+
+// Iterator counters, only compiled in when RIFF_FILE_STATS is defined
+#ifdef RIFF_FILE_STATS
+#define RIFF_FILE_STAT_ADD(n, field, v)  ((n)->stats.field += (v))
+#define RIFF_FILE_STAT_MAX(n, field, v)  do { if ((v) > (n)->stats.field) { (n)->stats.field = (v); } } while (0)
+#define RIFF_FILE_STAT_TIME_START()      uint64_t stat_start_ns = stats_now_ns()
+#define RIFF_FILE_STAT_TIME_END(n)       ((n)->stats.ns += stats_now_ns() - stat_start_ns)
+#else
+#define RIFF_FILE_STAT_ADD(n, field, v)  ((void)0)
+#define RIFF_FILE_STAT_MAX(n, field, v)  ((void)0)
+#define RIFF_FILE_STAT_TIME_START()      ((void)0)
+#define RIFF_FILE_STAT_TIME_END(n)       ((void)0)
+#endif
+
+// USDT probes for bpftrace and SystemTap, provider "riff_file", compiled in when
+// <sys/sdt.h> is available unless RIFF_FILE_NO_USDT is defined, a probe is a single
+// nop until attached. Probes and arguments:
+//   open_start (filename)
+//   open_done  (file, filename, file size), file is NULL if open failed
+//   chunk      (file, offset, id, size), data chunk yielded by iterator
+//   list_start (file, offset, type, size, level), LIST pushed, level is new list level
+//   list_end   (file, offset, level), LIST popped at end offset, level is list level ended
+//   close      (file)
+// ids and types are RIFF_FILE_FOURCC integers
+#if !defined(RIFF_FILE_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RIFF_FILE_USDT
+#endif
+#endif
+#ifdef RIFF_FILE_USDT
+#define RIFF_FILE_PROBE1(name, a)                DTRACE_PROBE1(riff_file, name, a)
+#define RIFF_FILE_PROBE3(name, a, b, c)          DTRACE_PROBE3(riff_file, name, a, b, c)
+#define RIFF_FILE_PROBE4(name, a, b, c, d)       DTRACE_PROBE4(riff_file, name, a, b, c, d)
+#define RIFF_FILE_PROBE5(name, a, b, c, d, e)    DTRACE_PROBE5(riff_file, name, a, b, c, d, e)
+#else
+#define RIFF_FILE_PROBE1(name, a)                ((void)0)
+#define RIFF_FILE_PROBE3(name, a, b, c)          ((void)0)
+#define RIFF_FILE_PROBE4(name, a, b, c, d)       ((void)0)
+#define RIFF_FILE_PROBE5(name, a, b, c, d, e)    ((void)0)
+#endif
+
+// Size of window used for reading chunk headers when file is not mapped
+#define RIFF_FILE_HEADER_WINDOW_SIZE (4096)
+
+// Number of reads queued at once on io_uring backend
+#define RIFF_FILE_URING_ENTRIES (64)
+
+// Max threads used by parallel index build
+#define RIFF_FILE_PARALLEL_MAX_THREADS (64)
+// Plausible headers in a row needed before parallel worker starts walking a region
+#define RIFF_FILE_PARALLEL_CHAIN_CONFIRM (8)
+// Start offsets tried in each region, region is left to sequential walk if none is found
+#define RIFF_FILE_PARALLEL_RESYNC_LIMIT (64 * 1024)
+// Top level chunks between points where sequential walk may join a parallel region walk
+#define RIFF_FILE_PARALLEL_SYNC_INTERVAL (64)
+// Least bytes per parallel index thread, smaller files are walked faster than threads start
+#define RIFF_FILE_PARALLEL_MIN_REGION (16 * 1024 * 1024)
+
+// ds64 chunk: riff size, data size, sample count, table length, then table
+#define RIFF_FILE_DS64_HEADER_SIZE (28)
+#define RIFF_FILE_DS64_ENTRY_SIZE  (12)
+// Max ds64 table entries kept, table is normally empty
+#define RIFF_FILE_DS64_MAX_ENTRIES (16)
+
+//------------------------------------------------------------------
+
+// Initial number of entries allocated for chunk index
+#define RIFF_FILE_INDEX_INITIAL_ENTRIES (64)
+
+// Multiplier for FourCC hash, Fibonacci hashing
+#define RIFF_FILE_INDEX_HASH_MULT (0x9e3779b1u)
+
+// Sidecar index file name suffix, magic and format version,
+// version 2 offsets step over pad bytes after odd sized chunks
+#define RIFF_FILE_INDEX_CACHE_SUFFIX  ".rfidx"
+#define RIFF_FILE_INDEX_CACHE_MAGIC   "RFIX"
+#define RIFF_FILE_INDEX_CACHE_VERSION (2)
 
 //------------------------------------------------------------------
 
+// 64 bit chunk size from ds64 table
+struct riff_file_ds64_entry_s
+{
+  char id[4];
+  uint64_t size;
+};
+
+// 64 bit sizes from RF64/BW64 ds64 chunk, used for chunks with size 0xffffffff
+struct riff_file_ds64_s
+{
+  uint64_t riff_size;
+  uint64_t data_size;
+  uint64_t sample_count;
+  uint32_t count;
+  struct riff_file_ds64_entry_s entries[RIFF_FILE_DS64_MAX_ENTRIES];
+};
+
+// Hash bucket for chunk id lookup, open addressing with linear probing
+struct riff_file_index_bucket_s
+{
+  uint32_t id;
+  // first and last entry with id, -1 if bucket is empty
+  int32_t first;
+  int32_t last;
+  uint32_t count;
+};
+
+// Sidecar index file header, entries follow header
+struct riff_file_index_cache_header_s
+{
+  char     magic[4];
+  uint32_t version;
+  uint32_t entry_size;
+  uint32_t reserved;
+  // indexed file identity, cache is stale if any differs
+  uint64_t file_size;
+  int64_t  mtime_sec;
+  int64_t  mtime_nsec;
+  uint64_t inode;
+  uint64_t dev;
+  uint64_t count;
+};
+
+// Struct describing chunk index of RIFF file
+struct riff_file_index_s
+{
+  struct riff_file_s *file;
+  // entries are in mapped sidecar file if map is set, otherwise allocated
+  struct riff_file_index_entry_s *entries;
+  void *map;
+  size_t map_size;
+  size_t count;
+  size_t capacity;
+  // id lookup table, built on first find
+  struct riff_file_index_bucket_s *buckets;
+  uint32_t bucket_shift;
+  // next entry with same id, -1 if last
+  int32_t *next;
+  // innermost LIST entry that may still be open, used while building
+  int32_t open_list;
+};
+
+struct riff_file_s;
+
+// I/O backend operations
+struct riff_file_io_ops_s
+{
+  enum riff_file_backend_e backend;
+  // setup backend for opened file, takes ownership of fd
+  int32_t (*open)(struct riff_file_s *f, int fd, const struct riff_file_open_options_s *options);
+  // perform reads, result of each read is stored in its request
+  int32_t (*read)(struct riff_file_s *f, struct riff_file_read_req_s *reqs, size_t n);
+  void    (*close)(struct riff_file_s *f);
+};
+
 // Struct describing RIFF file
 struct riff_file_s
 {
+  const struct riff_file_io_ops_s *io;
+  // file descriptor, only kept open if file is not mapped
   int fd;
   size_t size;
+  // file mapping, NULL if not using mmap backend
   void *vaddr;
+  // io_uring backend queue
+  struct riff_file_uring_s *uring;
+  struct riff_file_index_s *index;
+  // 64 bit sizes, NULL unless RF64/BW64 file
+  struct riff_file_ds64_s *ds64;
+  // sidecar index file path, NULL if index cache is not used
+  char *cache_path;
+  // identity of file, stored in sidecar index
+  struct stat stat;
+  // last error or diagnostic
+  struct riff_file_diag_s diag;
+  // form type from file header
+  char format[4];
+};
+
+// LIST nesting state, shared by iterator and stream parser
+struct riff_file_nesting_s
+{
+  // file offset of next chunk header
+  uint64_t offset;
+  int      list_level;
+  // file offset where each nested list ends, never beyond end of parent list,
+  // points to inline levels until nesting gets deeper and stack spills to heap
+  uint64_t *list_end;
+  int32_t  list_capacity;
+  uint64_t list_end_inline[RIFF_FILE_NESTING_INLINE_LEVELS];
+  // iterator flags, see riff_file_iterator_flag_e
+  uint32_t flags;
+  // 64 bit sizes of RF64/BW64 data, NULL if none
+  const struct riff_file_ds64_s *ds64;
+  // size of last consumed chunk, with 64 bit size substituted
+  uint64_t size;
+  // last error or diagnostic of iterator or stream parser
+  struct riff_file_diag_s diag;
+#ifdef RIFF_FILE_STATS
+  struct riff_file_iterator_stats_s stats;
+#endif
+};
+
+// Kind of chunk header consumed by nesting logic
+enum riff_file_header_kind_e
+{
+  RIFF_FILE_HEADER_DATA = 0,
+  RIFF_FILE_HEADER_LIST,
+  RIFF_FILE_HEADER_INFO,
+  // LIST nested too deep or heap stack could not grow, nothing consumed
+  RIFF_FILE_HEADER_ERROR,
+};
+
+// Heap stacks of nesting list ends freed by earlier users
+struct riff_file_nesting_pool_s
+{
+  pthread_mutex_t lock;
+  uint64_t *stack[RIFF_FILE_NESTING_POOL_SIZE];
+  int32_t  capacity[RIFF_FILE_NESTING_POOL_SIZE];
+  int32_t  count;
+};
+
+// Stream parser states
+enum riff_file_stream_state_e
+{
+  RIFF_FILE_STREAM_FILE_HEADER = 0,
+  RIFF_FILE_STREAM_CHUNK_HEADER,
+  RIFF_FILE_STREAM_PAYLOAD,
+  RIFF_FILE_STREAM_SKIP,
+  RIFF_FILE_STREAM_DONE,
+  RIFF_FILE_STREAM_ERROR,
+};
+
+// Struct describing RIFF stream parser
+struct riff_file_stream_s
+{
+  char type[4];
+  struct riff_file_stream_callbacks_s cb;
+  void *user;
+  enum riff_file_stream_state_e state;
+  struct riff_file_nesting_s nest;
+  // stream offset of next byte pushed
+  uint64_t pos;
+  // payload bytes left to deliver or skip
+  uint64_t remaining;
+  // pad byte skipped after payload is delivered
+  uint32_t pad;
+  // partially received header
+  char     hdr[sizeof(struct riff_file_list_chunk_s)];
+  uint32_t hdr_len;
+  // RF64/BW64 stream, ds64 chunk payload is collected while it passes
+  bool     rf64;
+  bool     ds64_collect;
+  uint32_t ds64_len;
+  uint8_t  ds64_raw[RIFF_FILE_DS64_HEADER_SIZE + RIFF_FILE_DS64_MAX_ENTRIES * RIFF_FILE_DS64_ENTRY_SIZE];
+  struct riff_file_ds64_s ds64;
+};
+
+// Top level offset in region walk, and number of entries walked before it
+struct riff_file_chain_sync_s
+{
+  uint64_t offset;
+  size_t entry;
+};
+
+// Index entries of one top level region, walked by parallel index worker.
+// Walk starts at first offset in region holding a run of plausible headers, which may
+// be inside a LIST, so entries are only used from a sync point sequential walk lands on
+struct riff_file_chain_s
+{
+  struct riff_file_s *file;
+  // region searched for start
+  uint64_t begin;
+  uint64_t end;
+  // top level offsets where walk started and stopped
+  uint64_t start;
+  uint64_t stop;
+  // entries of walk, parent links are local to region
+  struct riff_file_index_s part;
+  // top level offsets of walk, every few top level chunks
+  struct riff_file_chain_sync_s *sync;
+  size_t sync_count;
+  size_t sync_capacity;
+  // last diagnostic of walk, reported only if it is at or after sync point where entries are used
+  struct riff_file_diag_s diag;
+  pthread_t thread;
+  bool found;
+};
+
+// Regions walked by parallel index workers, in file order
+struct riff_file_chains_s
+{
+  struct riff_file_chain_s *chain;
+  int32_t count;
 };
 
 // Struct describing RIFF file data chunk iterator
 struct riff_file_iterator_s
 {
   struct riff_file_s *file;
-  char *addr;
-  int    list_level;
-  size_t list_size[RIFF_FILE_NESTED_LIST_MAX_LEVELS];
+  struct riff_file_nesting_s nest;
   riff_file_list_chunk_start_fn_t list_start_cb;
   riff_file_list_chunk_end_fn_t   list_end_cb;
+  // chunk headers read from file when it is not mapped
+  uint64_t window_offset;
+  size_t   window_len;
+  char     window[RIFF_FILE_HEADER_WINDOW_SIZE];
 };
 
+// log callback, set by user
+static riff_file_log_fn_t diag_log_fn;
+static void *diag_log_user;
+
+// error of last failed open on each thread, there is no handle to hold it
+static __thread struct riff_file_diag_s diag_open;
+
+// set on parallel index workers, their walks are speculative and are not logged
+static __thread bool diag_quiet;
+
 //------------------------------------------------------------------
-riff_file_h riff_file_open(const char *filename, const char type[4])
+// record error on handle if there is one and pass it to log callback,
+// kept out of line so callers on parsing path stay small
+__attribute__((cold, noinline))
+static void diag_report(struct riff_file_diag_s *slot, enum riff_file_error_e error, int sys_errno,
+                        uint64_t offset, const char *id, int32_t level)
 {
-  struct riff_file_s *f = (struct riff_file_s *)malloc(sizeof(struct riff_file_s));
-  if (f == NULL) {
-    perror("malloc file failed");
-    return NULL;
+  struct riff_file_diag_s d;
+  d.error     = error;
+  d.sys_errno = sys_errno;
+  d.offset    = offset;
+  if (id != NULL) {
+    memcpy(d.id, id, 4);
   }
+  else {
+    memset(d.id, 0, 4);
+  }
+  d.level = level;
+  if (slot != NULL) {
+    *slot = d;
+  }
+  if (!diag_quiet) {
+    riff_file_log(&d);
+  }
+}
 
-  // try open file
-  int fd = open(filename, O_RDONLY);
-  if (fd < 0) {
-    perror("file open failed");
-    free(f);
-    return NULL;
+//------------------------------------------------------------------
+void riff_file_log(const struct riff_file_diag_s *diag)
+{
+  if (diag_log_fn != NULL) {
+    diag_log_fn(diag, diag_log_user);
   }
+}
 
-  // get file size
-  struct stat fst;
-  if (fstat(fd, &fst) != 0) {
-    perror("file stat failed");
-    free(f);
-    return NULL;
+//------------------------------------------------------------------
+void riff_file_set_open_error(const struct riff_file_diag_s *diag)
+{
+  if (diag != NULL) {
+    diag_open = *diag;
+  }
+  else {
+    memset(&diag_open, 0, sizeof(diag_open));
+  }
+}
+
+//------------------------------------------------------------------
+void riff_file_set_log_callback(riff_file_log_fn_t log_fn, void *user)
+{
+  diag_log_user = user;
+  diag_log_fn   = log_fn;
+}
+
+//------------------------------------------------------------------
+const char* riff_file_error_string(enum riff_file_error_e error)
+{
+  switch (error) {
+  case RIFF_FILE_ERROR_NONE:           return "no error";
+  case RIFF_FILE_ERROR_OPEN:           return "file open failed";
+  case RIFF_FILE_ERROR_BACKEND:        return "I/O backend setup failed";
+  case RIFF_FILE_ERROR_READ:           return "file read failed";
+  case RIFF_FILE_ERROR_NO_MEMORY:      return "out of memory";
+  case RIFF_FILE_ERROR_HEADER:         return "no valid riff header";
+  case RIFF_FILE_ERROR_DS64:           return "no valid ds64 chunk";
+  case RIFF_FILE_ERROR_LIST_UNDERFLOW: return "LIST chunk size underflow";
+  case RIFF_FILE_ERROR_NESTING_DEPTH:  return "LIST chunks nested too deep";
+  case RIFF_FILE_ERROR_NOT_MAPPED:     return "file not mapped, use chunk descriptors";
+  case RIFF_FILE_ERROR_CHUNK_SIZE:     return "chunk size error";
+  case RIFF_FILE_ERROR_ADVISE:         return "file access hint failed";
+  case RIFF_FILE_ERROR_INDEX_CACHE:    return "index cache write failed";
+  case RIFF_FILE_ERROR_INVALID_HANDLE: return "invalid handle";
+  case RIFF_FILE_ERROR_WRITE:          return "file write failed";
+  case RIFF_FILE_ERROR_WRITER_STATE:   return "writer call out of order";
+  case RIFF_FILE_ERROR_THREAD:         return "worker thread start failed";
+  case RIFF_FILE_ERROR_MISSING_CHUNK:  return "required chunk missing";
+  case RIFF_FILE_ERROR_FORMAT:         return "format not valid or not supported";
+  default:                             return "unknown error";
+  }
+}
+
+//------------------------------------------------------------------
+static enum riff_file_error_e diag_get(const struct riff_file_diag_s *slot, struct riff_file_diag_s *diag)
+{
+  if (diag != NULL) {
+    *diag = *slot;
+  }
+  return slot->error;
+}
+
+//------------------------------------------------------------------
+enum riff_file_error_e riff_file_get_open_error(struct riff_file_diag_s *diag)
+{
+  return diag_get(&diag_open, diag);
+}
+
+//------------------------------------------------------------------
+enum riff_file_error_e riff_file_get_error(riff_file_h file_h, struct riff_file_diag_s *diag)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  return diag_get(&f->diag, diag);
+}
+
+//------------------------------------------------------------------
+static void file_advise(struct riff_file_s *f, enum riff_file_access_e access)
+{
+  int res = 0;
+  switch (access) {
+  case RIFF_FILE_ACCESS_SEQUENTIAL:
+    // aggressive readahead, and start reading whole file in background
+    res = madvise(f->vaddr, f->size, MADV_SEQUENTIAL);
+    if (res == 0) {
+      res = madvise(f->vaddr, f->size, MADV_WILLNEED);
+    }
+    break;
+  case RIFF_FILE_ACCESS_RANDOM:
+    res = madvise(f->vaddr, f->size, MADV_RANDOM);
+    break;
+  default:
+    break;
+  }
+  // only a hint, file is still usable
+  if (res != 0) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_ADVISE, errno, 0, NULL, 0);
   }
-  f->size = fst.st_size;
+}
 
+//------------------------------------------------------------------
+static int32_t mmap_open(struct riff_file_s *f, int fd, const struct riff_file_open_options_s *options)
+{
   // memory map file
+  int flags = MAP_PRIVATE;
+  if (options->populate) {
+    flags |= MAP_POPULATE;
+  }
   void *file_addr = mmap(0,           //addr
                          f->size,     //length
                          PROT_READ,   //prot
-                         MAP_PRIVATE, //flags
+                         flags,       //flags
                          fd,          //fd
                          0            //offset 
                          );
   if (file_addr == MAP_FAILED) {
-    perror("mmap file failed");
+    diag_report(&f->diag, RIFF_FILE_ERROR_BACKEND, errno, 0, NULL, 0);
     close(fd);
-    free(f);
-    return NULL;
+    return -1;
   }
   else {
     close(fd);
   }
+  f->vaddr = file_addr;
+  file_advise(f, options->access);
+  return 0;
+}
 
-  // check headers and sizes
-  void *file_end = file_addr + f->size;
-  if ((file_end - file_addr) < (int)sizeof(struct riff_file_header_chunk_s)) {
-    fprintf(stderr, "riff header too short\n");
-    int res = munmap(0, f->size);
-    if (res != 0) {
-      perror("munmap file failed");
+//------------------------------------------------------------------
+static int32_t mmap_read(struct riff_file_s *f, struct riff_file_read_req_s *reqs, size_t n)
+{
+  size_t i;
+  for (i = 0; i < n; i++) {
+    size_t len = reqs[i].len;
+    if (reqs[i].offset >= f->size) {
+      len = 0;
     }
-    free(f);
-    return NULL;
+    else if (len > (f->size - reqs[i].offset)) {
+      len = f->size - reqs[i].offset;
+    }
+    memcpy(reqs[i].buf, (char*)f->vaddr + reqs[i].offset, len);
+    reqs[i].result = (int64_t)len;
   }
-  f->vaddr = file_addr;
-
-  // check header
-  struct riff_file_header_chunk_s *header = (struct riff_file_header_chunk_s *)f->vaddr;
+  return 0;
+}
 
-  // check type and format
-  if ((memcmp(header->id, RIFF_FILE_TYPE_FILE_MAGIC, 4) != 0) ||
-      (memcmp(header->format, type, 4) != 0)) {
-    fprintf(stderr, "no valid riff header\n");
-    fprintf(stderr, "id 0x%02x:0x%02x:0x%02x:0x%02x \"%c%c%c%c\"\n",
-            header->id[0], header->id[1], header->id[2], header->id[3],
-            header->id[0], header->id[1], header->id[2], header->id[3]);
-    fprintf(stderr, "format 0x%02x:0x%02x:0x%02x:0x%02x \"%c%c%c%c\"\n",
-            header->format[0], header->format[1], header->format[2], header->format[3],
-            header->format[0], header->format[1], header->format[2], header->format[3]);
-    int res = munmap(0, f->size);
-    if (res != 0) {
-      perror("file munmap failed");
-    }
-    free(f);
-    return NULL;
+//------------------------------------------------------------------
+static void mmap_close(struct riff_file_s *f)
+{
+  int res = munmap(f->vaddr, f->size);
+  if (res != 0) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_BACKEND, errno, 0, NULL, 0);
   }
+}
 
-  // success
-  return (void*)f;
+//------------------------------------------------------------------
+static int32_t pread_open(struct riff_file_s *f, int fd, const struct riff_file_open_options_s *options)
+{
+  f->fd = fd;
+  // only a hint, same as for mapped file
+  if (options->access == RIFF_FILE_ACCESS_SEQUENTIAL) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+  else if ((options->access == RIFF_FILE_ACCESS_RANDOM) ||
+           (options->access == RIFF_FILE_ACCESS_HEADERS_ONLY)) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+  }
+  return 0;
 }
 
 //------------------------------------------------------------------
-riff_file_data_chunk_iterator_h riff_file_data_chunk_iterator_new(riff_file_h file_h,
-                                                                  riff_file_list_chunk_start_fn_t list_start_cb,
-                                                                  riff_file_list_chunk_end_fn_t   list_end_cb)
+static int32_t pread_read(struct riff_file_s *f, struct riff_file_read_req_s *reqs, size_t n)
 {
-  struct riff_file_s *f = (struct riff_file_s *)file_h;
-  if (f != NULL) {
-    struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)malloc(sizeof(struct riff_file_iterator_s));
-    if (it == NULL) {
-      perror("malloc file iterator failed");
-      return NULL;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    size_t  done = 0;
+    int64_t error = 0;
+    while (done < reqs[i].len) {
+      ssize_t res = pread(f->fd, (char*)reqs[i].buf + done, reqs[i].len - done, (off_t)(reqs[i].offset + done));
+      if ((res < 0) && (errno == EINTR)) {
+        continue;
+      }
+      if (res < 0) {
+        error = -errno;
+        break;
+      }
+      if (res == 0) {
+        // end of file
+        break;
+      }
+      done += res;
     }
-    it->file = f;
-    it->addr = ((char*)f->vaddr) + sizeof(struct riff_file_header_chunk_s);
-    it->list_level    = 0;
-    it->list_size[0]  = f->size - sizeof(struct riff_file_header_chunk_s);
-    it->list_start_cb = list_start_cb;
-    it->list_end_cb   = list_end_cb;
-    return it;
-  }
-  else {
-    perror("invalid file handle");
-    return NULL;
+    reqs[i].result = (error < 0) ? error : (int64_t)done;
   }
+  return 0;
 }
 
-//---------------------------------------------
-int32_t riff_file_data_chunk_iterator_get_list_level(riff_file_data_chunk_iterator_h iter_h)
+//------------------------------------------------------------------
+static void pread_close(struct riff_file_s *f)
 {
-  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
-  return it->list_level;
+  close(f->fd);
 }
 
-//---------------------------------------------
-static void sub_all_lists(struct riff_file_iterator_s *it, int len)
+//------------------------------------------------------------------
+static int32_t uring_open(struct riff_file_s *f, int fd, const struct riff_file_open_options_s *options)
 {
-  int i;
-  for (i = 0; i <= it->list_level; i++) {
-    if (it->list_size[i] >= (size_t)len) {
-      it->list_size[i] -= len;
-    }
-    else {
-      // @see https://www.recordingblogs.com/wiki/list-chunk-of-a-wave-file
-      perror("LIST chunk size underflow error");
-      printf("!!! SUBLIST[%d] UNDERFLOW ERROR !!! LEFT %d LEN %d\n", i, (int)it->list_size[i], len);
-      it->list_size[i] = 0;
-    }
+  f->uring = riff_file_uring_new(fd, RIFF_FILE_URING_ENTRIES);
+  if (f->uring == NULL) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_BACKEND, errno, 0, NULL, 0);
+    close(fd);
+    return -1;
   }
+  return pread_open(f, fd, options);
 }
 
 //------------------------------------------------------------------
-struct riff_file_data_subchunk_s* riff_file_data_chunk_iterator_next(riff_file_data_chunk_iterator_h iter_h)
+static int32_t uring_read(struct riff_file_s *f, struct riff_file_read_req_s *reqs, size_t n)
 {
-  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
-  char *cur_addr = it->addr;
+  return riff_file_uring_read(f->uring, reqs, n);
+}
 
-  while ((it->list_level > 0) && (it->list_size[it->list_level] == 0)) {
-    // list done
-    if (it->list_end_cb != NULL) {
-      it->list_end_cb(iter_h, it->list_level);
-    }
-    it->list_level--;
-  }
+//------------------------------------------------------------------
+static void uring_close(struct riff_file_s *f)
+{
+  riff_file_uring_delete(f->uring);
+  close(f->fd);
+}
 
-  // check if all file done
-  if ((it->list_level == 0) && (it->list_size[0] == 0)) {
-    // end of file, no more data to read
-    return NULL;
-  }
+//------------------------------------------------------------------
 
-  // check if list chunk
-  if (memcmp(cur_addr, RIFF_FILE_TYPE_LIST_MAGIC, 4) == 0) {
-    // list
-    struct riff_file_list_chunk_s *list = (struct riff_file_list_chunk_s *)cur_addr;
+static const struct riff_file_io_ops_s riff_file_io_mmap = {
+  RIFF_FILE_BACKEND_MMAP, mmap_open, mmap_read, mmap_close
+};
 
-    // skip list header and list size
-    it->addr += 8;
-    sub_all_lists(it, 8);
+static const struct riff_file_io_ops_s riff_file_io_pread = {
+  RIFF_FILE_BACKEND_PREAD, pread_open, pread_read, pread_close
+};
 
-    it->list_level++;
-    assert(it->list_level < RIFF_FILE_NESTED_LIST_MAX_LEVELS);
-    // store length of 'payload'
-    it->list_size[ it->list_level ] = list->size;
+static const struct riff_file_io_ops_s riff_file_io_uring = {
+  RIFF_FILE_BACKEND_IO_URING, uring_open, uring_read, uring_close
+};
+
+//------------------------------------------------------------------
+// read at offset, reads past end of file are short
+//@return bytes read, -1 on error
+static int64_t file_read(struct riff_file_s *f, uint64_t offset, void *buf, size_t len)
+{
+  struct riff_file_read_req_s req = { offset, buf, len, 0 };
+  if (f->io->read(f, &req, 1) != 0) {
+    return -1;
+  }
+  if (req.result < 0) {
+    errno = (int)-req.result;
+    return -1;
+  }
+  return req.result;
+}
 
-    // if AVI movi tag, just skip data
-    if (memcmp(list->type, RIFF_FILE_TYPE_AVI_MOVI_MAGIC, 4) == 0) {
-      it->addr += list->size;
-      sub_all_lists(it, list->size);
+//------------------------------------------------------------------
+static void file_release(struct riff_file_s *f)
+{
+  if (f->io != NULL) {
+    f->io->close(f);
+  }
+  if (f->index != NULL) {
+    free(f->index->buckets);
+    free(f->index->next);
+    if (f->index->map != NULL) {
+      munmap(f->index->map, f->index->map_size);
     }
     else {
-      // skip list type
-      it->addr += 4;
-      sub_all_lists(it, 4);
+      free(f->index->entries);
     }
+    free(f->index);
+  }
+  free(f->ds64);
+  free(f->cache_path);
+  free(f);
+}
 
-    if (it->list_start_cb != NULL) {
-      it->list_start_cb(iter_h, it->list_level, list->id, list->size, list->type);
-    }
+//------------------------------------------------------------------
+static bool file_magic_rf64(const char *id)
+{
+  uint32_t fourcc = riff_file_fourcc(id);
+  return (fourcc == RIFF_FILE_FOURCC_RF64) || (fourcc == RIFF_FILE_FOURCC_BW64);
+}
 
-    return riff_file_data_chunk_iterator_next(iter_h);
+//------------------------------------------------------------------
+// decode ds64 chunk payload, table entries beyond max are dropped
+//@return 0 on success, -1 if too short
+static int32_t ds64_decode(struct riff_file_ds64_s *d, const uint8_t *buf, size_t len)
+{
+  if (len < RIFF_FILE_DS64_HEADER_SIZE) {
+    return -1;
   }
-  else if (memcmp(cur_addr, RIFF_FILE_TYPE_INFO_MAGIC, 4) == 0) {
-    it->addr += 4;
-    sub_all_lists(it, 4);
-    return riff_file_data_chunk_iterator_next(iter_h);
+  uint32_t count;
+  memcpy(&d->riff_size,    buf,      8);
+  memcpy(&d->data_size,    buf + 8,  8);
+  memcpy(&d->sample_count, buf + 16, 8);
+  memcpy(&count,           buf + 24, 4);
+  if (count > (len - RIFF_FILE_DS64_HEADER_SIZE) / RIFF_FILE_DS64_ENTRY_SIZE) {
+    count = (uint32_t)((len - RIFF_FILE_DS64_HEADER_SIZE) / RIFF_FILE_DS64_ENTRY_SIZE);
   }
-  else {
-    // All chunks are aligned?
-    struct riff_file_data_subchunk_s *subchunk = (struct riff_file_data_subchunk_s *)cur_addr;    
+  if (count > RIFF_FILE_DS64_MAX_ENTRIES) {
+    count = RIFF_FILE_DS64_MAX_ENTRIES;
+  }
+  uint32_t i;
+  for (i = 0; i < count; i++) {
+    const uint8_t *e = buf + RIFF_FILE_DS64_HEADER_SIZE + i * RIFF_FILE_DS64_ENTRY_SIZE;
+    memcpy(d->entries[i].id, e, 4);
+    memcpy(&d->entries[i].size, e + 4, 8);
+  }
+  d->count = count;
+  return 0;
+}
+
+//------------------------------------------------------------------
+// read ds64 chunk, must be first chunk of RF64/BW64 file
+//@return 0 on success, -1 if missing
+static int32_t file_read_ds64(struct riff_file_s *f)
+{
+  uint8_t buf[sizeof(struct riff_file_data_subchunk_s) + RIFF_FILE_DS64_HEADER_SIZE +
+              RIFF_FILE_DS64_MAX_ENTRIES * RIFF_FILE_DS64_ENTRY_SIZE];
+  int64_t len = file_read(f, sizeof(struct riff_file_header_chunk_s), buf, sizeof(buf));
+  if ((len < (int64_t)sizeof(struct riff_file_data_subchunk_s)) ||
+      (riff_file_fourcc((const char *)buf) != RIFF_FILE_FOURCC_DS64)) {
+    return -1;
+  }
+  uint32_t size;
+  memcpy(&size, buf + 4, 4);
+  len -= sizeof(struct riff_file_data_subchunk_s);
+  if (len > size) {
+    len = size;
+  }
+  f->ds64 = (struct riff_file_ds64_s *)malloc(sizeof(struct riff_file_ds64_s));
+  if (f->ds64 == NULL) {
+    return -1;
+  }
+  return ds64_decode(f->ds64, buf + sizeof(struct riff_file_data_subchunk_s), (size_t)len);
+}
 
-    it->addr += 8;
-    sub_all_lists(it, 8);
-    it->addr += subchunk->size;
-    sub_all_lists(it, subchunk->size);
+//------------------------------------------------------------------
+// fill sidecar header with identity of file
+static void index_cache_header(const struct riff_file_s *f, struct riff_file_index_cache_header_s *hdr, uint64_t count)
+{
+  memset(hdr, 0, sizeof(struct riff_file_index_cache_header_s));
+  memcpy(hdr->magic, RIFF_FILE_INDEX_CACHE_MAGIC, 4);
+  hdr->version    = RIFF_FILE_INDEX_CACHE_VERSION;
+  hdr->entry_size = sizeof(struct riff_file_index_entry_s);
+  hdr->file_size  = f->size;
+  hdr->mtime_sec  = f->stat.st_mtim.tv_sec;
+  hdr->mtime_nsec = f->stat.st_mtim.tv_nsec;
+  hdr->inode      = f->stat.st_ino;
+  hdr->dev        = f->stat.st_dev;
+  hdr->count      = count;
+}
 
-    return subchunk;
+//------------------------------------------------------------------
+// sidecar is only matched to file by identity, so entries are checked before they are trusted,
+// every chunk header must lie inside file and parent links must point back to earlier entries,
+// sizes are kept as in headers, as in index built by walk, and may run past end of truncated file
+static bool index_cache_valid(const struct riff_file_s *f, const struct riff_file_index_entry_s *entries, size_t count)
+{
+  uint64_t header_size = sizeof(struct riff_file_data_subchunk_s);
+  size_t i;
+  for (i = 0; i < count; i++) {
+    const struct riff_file_index_entry_s *e = &entries[i];
+    if ((e->offset > f->size) ||
+        (header_size > (f->size - e->offset)) ||
+        (e->level < 0) ||
+        (e->parent < -1) || (e->parent >= (int64_t)i)) {
+      return false;
+    }
   }
+  return true;
 }
 
 //------------------------------------------------------------------
-int32_t riff_file_data_chunk_iterator_delete(riff_file_data_chunk_iterator_h iter_h)
+// map sidecar index if it matches file, missing, stale or corrupt sidecar is not an error
+static void index_cache_load(struct riff_file_s *f)
 {
-  free(iter_h);
-  return 0;
+  int fd = open(f->cache_path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat cst;
+  if ((fstat(fd, &cst) != 0) || ((size_t)cst.st_size < sizeof(struct riff_file_index_cache_header_s))) {
+    close(fd);
+    return;
+  }
+  size_t map_size = cst.st_size;
+  void *map = mmap(0, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return;
+  }
+  const struct riff_file_index_cache_header_s *hdr = (const struct riff_file_index_cache_header_s *)map;
+  struct riff_file_index_cache_header_s expect;
+  index_cache_header(f, &expect, hdr->count);
+  size_t entries_size = map_size - sizeof(struct riff_file_index_cache_header_s);
+  if ((memcmp(hdr, &expect, sizeof(expect)) != 0) ||
+      (hdr->count != entries_size / sizeof(struct riff_file_index_entry_s)) ||
+      ((entries_size % sizeof(struct riff_file_index_entry_s)) != 0) ||
+      !index_cache_valid(f, (const struct riff_file_index_entry_s *)(hdr + 1), hdr->count)) {
+    munmap(map, map_size);
+    return;
+  }
+  struct riff_file_index_s *idx = (struct riff_file_index_s *)calloc(1, sizeof(struct riff_file_index_s));
+  if (idx == NULL) {
+    munmap(map, map_size);
+    return;
+  }
+  idx->file     = f;
+  idx->entries  = (struct riff_file_index_entry_s *)((char*)map + sizeof(struct riff_file_index_cache_header_s));
+  idx->count    = hdr->count;
+  idx->capacity = hdr->count;
+  idx->map      = map;
+  idx->map_size = map_size;
+  f->index = idx;
 }
 
 //------------------------------------------------------------------
-int32_t riff_file_close(riff_file_h file_h)
+// write sidecar index after index was built, written to temporary file and renamed into place
+static void index_cache_store(struct riff_file_s *f)
 {
-  struct riff_file_s *f = (struct riff_file_s *)file_h;
-  int res = munmap(f->vaddr, f->size);
-  if (res != 0) {
-    perror("file munmap failed");
+  if ((f->cache_path == NULL) || (f->index == NULL) || (f->index->map != NULL)) {
+    return;
+  }
+  size_t len = strlen(f->cache_path) + 32;
+  char *tmp_path = (char *)malloc(len);
+  if (tmp_path == NULL) {
+    return;
+  }
+  // unique per store, threads of one process may store same sidecar at once
+  static uint32_t index_cache_seq;
+  snprintf(tmp_path, len, "%s.%d.%u.tmp", f->cache_path, (int)getpid(),
+           (unsigned int)__atomic_add_fetch(&index_cache_seq, 1, __ATOMIC_RELAXED));
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_INDEX_CACHE, errno, 0, NULL, 0);
+    free(tmp_path);
+    return;
+  }
+  struct riff_file_index_cache_header_s hdr;
+  index_cache_header(f, &hdr, f->index->count);
+  struct iovec iov[2] = {
+    { &hdr, sizeof(hdr) },
+    { f->index->entries, f->index->count * sizeof(struct riff_file_index_entry_s) },
+  };
+  ssize_t res = writev(fd, iov, 2);
+  int err = errno;
+  close(fd);
+  if (res != (ssize_t)(iov[0].iov_len + iov[1].iov_len)) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_INDEX_CACHE, (res < 0) ? err : 0, 0, NULL, 0);
+    unlink(tmp_path);
+  }
+  else if (rename(tmp_path, f->cache_path) != 0) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_INDEX_CACHE, errno, 0, NULL, 0);
+    unlink(tmp_path);
   }
-  free(file_h);
+  free(tmp_path);
+}
+
+//------------------------------------------------------------------
+riff_file_h riff_file_open(const char *filename, const char type[4])
+{
+  return riff_file_open_ex(filename, type, NULL);
+}
+
+//------------------------------------------------------------------
+static struct riff_file_s* file_open(const char *filename, const char type[4],
+                                     const struct riff_file_open_options_s *options)
+{
+  struct riff_file_open_options_s default_options = { RIFF_FILE_ACCESS_DEFAULT, false, RIFF_FILE_BACKEND_MMAP, false };
+  if (options == NULL) {
+    options = &default_options;
+  }
+
+  struct riff_file_s *f = (struct riff_file_s *)malloc(sizeof(struct riff_file_s));
+  if (f == NULL) {
+    diag_report(&diag_open, RIFF_FILE_ERROR_NO_MEMORY, errno, 0, NULL, 0);
+    return NULL;
+  }
+
+  // try open file
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    diag_report(&diag_open, RIFF_FILE_ERROR_OPEN, errno, 0, NULL, 0);
+    free(f);
+    return NULL;
+  }
+
+  // get file size
+  struct stat fst;
+  if (fstat(fd, &fst) != 0) {
+    diag_report(&diag_open, RIFF_FILE_ERROR_OPEN, errno, 0, NULL, 0);
+    close(fd);
+    free(f);
+    return NULL;
+  }
+  f->io    = NULL;
+  f->fd    = -1;
+  f->size  = fst.st_size;
+  f->vaddr = NULL;
+  f->uring = NULL;
+  f->index = NULL;
+  f->ds64  = NULL;
+  f->cache_path = NULL;
+  f->stat  = fst;
+  memset(&f->diag, 0, sizeof(f->diag));
+
+  // check headers and sizes
+  if (f->size < sizeof(struct riff_file_header_chunk_s)) {
+    diag_report(&diag_open, RIFF_FILE_ERROR_HEADER, 0, 0, NULL, 0);
+    close(fd);
+    free(f);
+    return NULL;
+  }
+
+  // select I/O backend, headers only access never maps file
+  const struct riff_file_io_ops_s *io = &riff_file_io_mmap;
+  if (options->backend == RIFF_FILE_BACKEND_IO_URING) {
+    io = &riff_file_io_uring;
+  }
+  else if ((options->backend == RIFF_FILE_BACKEND_PREAD) ||
+           (options->access == RIFF_FILE_ACCESS_HEADERS_ONLY)) {
+    io = &riff_file_io_pread;
+  }
+  if (io->open(f, fd, options) != 0) {
+    // backend recorded error on file
+    diag_open = f->diag;
+    free(f);
+    return NULL;
+  }
+  f->io = io;
+
+  // check header
+  struct riff_file_header_chunk_s header_chunk;
+  struct riff_file_header_chunk_s *header = &header_chunk;
+  if (file_read(f, 0, header, sizeof(struct riff_file_header_chunk_s)) != sizeof(struct riff_file_header_chunk_s)) {
+    diag_report(&diag_open, RIFF_FILE_ERROR_READ, errno, 0, NULL, 0);
+    file_release(f);
+    return NULL;
+  }
+
+  // check type and format
+  bool rf64 = file_magic_rf64(header->id);
+  if ((riff_file_fourcc(header->id) != RIFF_FILE_FOURCC_RIFF) && !rf64) {
+    diag_report(&diag_open, RIFF_FILE_ERROR_HEADER, 0, 0, header->id, 0);
+    file_release(f);
+    return NULL;
+  }
+  if ((type != NULL) && (memcmp(header->format, type, 4) != 0)) {
+    diag_report(&diag_open, RIFF_FILE_ERROR_HEADER, 0, 0, header->format, 0);
+    file_release(f);
+    return NULL;
+  }
+  memcpy(f->format, header->format, 4);
+
+  // RF64/BW64 keep 64 bit sizes in ds64 chunk
+  if (rf64 && (file_read_ds64(f) != 0)) {
+    diag_report(&diag_open, RIFF_FILE_ERROR_DS64, 0, sizeof(struct riff_file_header_chunk_s), NULL, 0);
+    file_release(f);
+    return NULL;
+  }
+
+  // index from sidecar file, only mapped here, read on use
+  if (options->index_cache) {
+    f->cache_path = (char *)malloc(strlen(filename) + sizeof(RIFF_FILE_INDEX_CACHE_SUFFIX));
+    if (f->cache_path != NULL) {
+      strcpy(f->cache_path, filename);
+      strcat(f->cache_path, RIFF_FILE_INDEX_CACHE_SUFFIX);
+      index_cache_load(f);
+    }
+  }
+
+  // success
+  return f;
+}
+
+//------------------------------------------------------------------
+riff_file_h riff_file_open_ex(const char *filename, const char type[4],
+                              const struct riff_file_open_options_s *options)
+{
+  RIFF_FILE_PROBE1(open_start, filename);
+  memset(&diag_open, 0, sizeof(diag_open));
+  struct riff_file_s *f = file_open(filename, type, options);
+  RIFF_FILE_PROBE3(open_done, f, filename, (f != NULL) ? (uint64_t)f->size : 0);
+  return (void*)f;
+}
+
+static struct riff_file_nesting_pool_s nesting_pool = { PTHREAD_MUTEX_INITIALIZER, { NULL }, { 0 }, 0 };
+
+#ifdef RIFF_FILE_STATS
+//---------------------------------------------
+static inline uint64_t stats_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+//---------------------------------------------
+static void nesting_init(struct riff_file_nesting_s *n, uint64_t offset, uint64_t end)
+{
+  n->offset        = offset;
+  n->list_level    = 0;
+  n->list_end      = n->list_end_inline;
+  n->list_capacity = RIFF_FILE_NESTING_INLINE_LEVELS;
+  n->list_end[0]   = end;
+  n->flags       = 0;
+  n->ds64        = NULL;
+  n->size        = 0;
+  memset(&n->diag, 0, sizeof(n->diag));
+#ifdef RIFF_FILE_STATS
+  memset(&n->stats, 0, sizeof(n->stats));
+#endif
+}
+
+//---------------------------------------------
+// return heap stack to pool, freed if pool is full
+static void nesting_release(struct riff_file_nesting_s *n)
+{
+  if (n->list_end == n->list_end_inline) {
+    return;
+  }
+  pthread_mutex_lock(&nesting_pool.lock);
+  if (nesting_pool.count < RIFF_FILE_NESTING_POOL_SIZE) {
+    nesting_pool.stack[nesting_pool.count]    = n->list_end;
+    nesting_pool.capacity[nesting_pool.count] = n->list_capacity;
+    nesting_pool.count++;
+    n->list_end = NULL;
+  }
+  pthread_mutex_unlock(&nesting_pool.lock);
+  free(n->list_end);
+  n->list_end      = n->list_end_inline;
+  n->list_capacity = RIFF_FILE_NESTING_INLINE_LEVELS;
+}
+
+//---------------------------------------------
+// double list end stack, taken from pool if one is large enough
+//@return 0 on success, -1 if too deep or out of memory
+static int32_t nesting_grow(struct riff_file_nesting_s *n)
+{
+  if (n->list_capacity >= RIFF_FILE_NESTED_LIST_MAX_LEVELS) {
+    diag_report(&n->diag, RIFF_FILE_ERROR_NESTING_DEPTH, 0, n->offset, RIFF_FILE_TYPE_LIST_MAGIC, n->list_level);
+    return -1;
+  }
+  int32_t capacity = n->list_capacity * 2;
+  uint64_t *stack = NULL;
+  int32_t i;
+  pthread_mutex_lock(&nesting_pool.lock);
+  for (i = 0; i < nesting_pool.count; i++) {
+    if (nesting_pool.capacity[i] >= capacity) {
+      stack    = nesting_pool.stack[i];
+      capacity = nesting_pool.capacity[i];
+      nesting_pool.count--;
+      nesting_pool.stack[i]    = nesting_pool.stack[nesting_pool.count];
+      nesting_pool.capacity[i] = nesting_pool.capacity[nesting_pool.count];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&nesting_pool.lock);
+  if (stack == NULL) {
+    stack = (uint64_t *)malloc((size_t)capacity * sizeof(uint64_t));
+    if (stack == NULL) {
+      diag_report(&n->diag, RIFF_FILE_ERROR_NO_MEMORY, errno, n->offset, RIFF_FILE_TYPE_LIST_MAGIC, n->list_level);
+      return -1;
+    }
+  }
+  memcpy(stack, n->list_end, (size_t)(n->list_level + 1) * sizeof(uint64_t));
+  nesting_release(n);
+  n->list_end      = stack;
+  n->list_capacity = capacity;
+  return 0;
+}
+
+//---------------------------------------------
+// chunk at hdr_offset runs past end of lists, reported once per list corrected
+__attribute__((cold, noinline))
+static void list_size_underflow(struct riff_file_nesting_s *n, uint64_t hdr_offset, const char *id)
+{
+  int i;
+  for (i = 0; i <= n->list_level; i++) {
+    if (n->offset > n->list_end[i]) {
+      // @see https://www.recordingblogs.com/wiki/list-chunk-of-a-wave-file
+      diag_report(&n->diag, RIFF_FILE_ERROR_LIST_UNDERFLOW, 0, hdr_offset, id, i);
+      // end list at current offset
+      n->list_end[i] = n->offset;
+      RIFF_FILE_STAT_ADD(n, underflows, 1);
+    }
+  }
+}
+
+//---------------------------------------------
+// advance over part of chunk starting at hdr_offset, header is only used for diagnostics
+static inline void nesting_advance(struct riff_file_nesting_s *n, uint64_t len, uint64_t hdr_offset, const char *hdr)
+{
+  // saturate, offset past every list end is ended as underflow
+  if (__builtin_add_overflow(n->offset, len, &n->offset)) {
+    n->offset = UINT64_MAX;
+  }
+  // list ends are nested, so only innermost list needs to be checked
+  if (n->offset > n->list_end[n->list_level]) {
+    list_size_underflow(n, hdr_offset, hdr);
+  }
+}
+
+//---------------------------------------------
+static inline bool nesting_list_done(const struct riff_file_nesting_s *n)
+{
+  return (n->list_level > 0) && (n->offset >= n->list_end[n->list_level]);
+}
+
+//---------------------------------------------
+static inline bool nesting_eof(const struct riff_file_nesting_s *n)
+{
+  return (n->list_level == 0) && (n->offset >= n->list_end[0]);
+}
+
+//---------------------------------------------
+// 64 bit size of chunk at current offset clamped to end of its list,
+// ds64 sizes are not bounded by header field so they can not be trusted
+__attribute__((cold, noinline))
+static uint64_t nesting_ds64_size(struct riff_file_nesting_s *n, const char id[4], uint64_t size)
+{
+  uint64_t end = n->list_end[n->list_level];
+  uint64_t room = 0;
+  if ((n->offset <= end) && ((end - n->offset) >= sizeof(struct riff_file_data_subchunk_s))) {
+    room = end - n->offset - sizeof(struct riff_file_data_subchunk_s);
+  }
+  if (size > room) {
+    diag_report(&n->diag, RIFF_FILE_ERROR_CHUNK_SIZE, 0, n->offset, id, n->list_level);
+    size = room;
+  }
+  return size;
+}
+
+//---------------------------------------------
+// chunk size, 0xffffffff is replaced by 64 bit size from ds64 if there is one
+static inline uint64_t nesting_chunk_size(struct riff_file_nesting_s *n, const char id[4], uint32_t size)
+{
+  if ((size != UINT32_MAX) || (n->ds64 == NULL)) {
+    return size;
+  }
+  uint32_t fourcc = riff_file_fourcc(id);
+  if (fourcc == RIFF_FILE_FOURCC_DATA) {
+    return nesting_ds64_size(n, id, n->ds64->data_size);
+  }
+  uint32_t i;
+  for (i = 0; i < n->ds64->count; i++) {
+    if (fourcc == riff_file_fourcc(n->ds64->entries[i].id)) {
+      return nesting_ds64_size(n, id, n->ds64->entries[i].size);
+    }
+  }
+  return size;
+}
+
+//---------------------------------------------
+// bytes of chunk header needed by nesting_consume_header, given first 4 bytes
+static inline uint32_t nesting_header_size(const char *hdr)
+{
+  switch (riff_file_fourcc(hdr)) {
+  case RIFF_FILE_FOURCC_LIST: return sizeof(struct riff_file_list_chunk_s);
+  case RIFF_FILE_FOURCC_INFO: return 4;
+  default: return sizeof(struct riff_file_data_subchunk_s);
+  }
+}
+
+//---------------------------------------------
+// consume chunk header at current offset, including payload of data chunks
+// and skipped AVI movi lists, LIST chunks start a new nesting level
+static enum riff_file_header_kind_e nesting_consume_header(struct riff_file_nesting_s *n, const char *hdr)
+{
+  // check if list chunk, id is loaded once and compared as integer
+  uint32_t fourcc = riff_file_fourcc(hdr);
+  uint64_t hdr_offset = n->offset;
+  if (fourcc == RIFF_FILE_FOURCC_LIST) {
+    // list, stack is grown before anything is consumed so error leaves state as is
+    if (((n->list_level + 1) >= n->list_capacity) && (nesting_grow(n) != 0)) {
+      return RIFF_FILE_HEADER_ERROR;
+    }
+    const struct riff_file_list_chunk_s *list = (const struct riff_file_list_chunk_s *)hdr;
+    n->size = nesting_chunk_size(n, list->id, list->size);
+
+    // skip list header and list size
+    nesting_advance(n, 8, hdr_offset, hdr);
+
+    n->list_level++;
+    RIFF_FILE_STAT_ADD(n, lists, 1);
+    RIFF_FILE_STAT_MAX(n, max_level, n->list_level);
+    // store end of 'payload', clamped to end of parent list, offset is not past parent end here
+    uint64_t list_end = n->list_end[n->list_level - 1];
+    if (n->size < (list_end - n->offset)) {
+      list_end = n->offset + n->size;
+    }
+    n->list_end[ n->list_level ] = list_end;
+
+    // if AVI movi tag, just skip data unless asked to descend into frames
+    if (((n->flags & RIFF_FILE_ITERATOR_DESCEND_MOVI) == 0) &&
+        (riff_file_fourcc(list->type) == RIFF_FILE_FOURCC_MOVI)) {
+      RIFF_FILE_STAT_ADD(n, bytes_visited, 8);
+      RIFF_FILE_STAT_ADD(n, bytes_skipped, n->size);
+      nesting_advance(n, n->size, hdr_offset, hdr);
+    }
+    else {
+      // skip list type
+      RIFF_FILE_STAT_ADD(n, bytes_visited, 12);
+      nesting_advance(n, 4, hdr_offset, hdr);
+    }
+    return RIFF_FILE_HEADER_LIST;
+  }
+  else if (fourcc == RIFF_FILE_FOURCC_INFO) {
+    RIFF_FILE_STAT_ADD(n, bytes_visited, 4);
+    nesting_advance(n, 4, hdr_offset, hdr);
+    return RIFF_FILE_HEADER_INFO;
+  }
+  else {
+    // All chunks are aligned?
+    const struct riff_file_data_subchunk_s *subchunk = (const struct riff_file_data_subchunk_s *)hdr;
+    n->size = nesting_chunk_size(n, subchunk->id, subchunk->size);
+    RIFF_FILE_STAT_ADD(n, chunks, 1);
+    RIFF_FILE_STAT_ADD(n, bytes_visited, 8 + n->size);
+    nesting_advance(n, 8, hdr_offset, hdr);
+    nesting_advance(n, n->size, hdr_offset, hdr);
+    // odd sized payload is followed by pad byte, missing pad at end of list is tolerated
+    if ((n->size & 1) && (n->offset < n->list_end[n->list_level])) {
+      n->offset++;
+    }
+    return RIFF_FILE_HEADER_DATA;
+  }
+}
+
+//------------------------------------------------------------------
+static void iterator_init(struct riff_file_iterator_s *it, struct riff_file_s *f,
+                          riff_file_list_chunk_start_fn_t list_start_cb,
+                          riff_file_list_chunk_end_fn_t   list_end_cb)
+{
+  it->file = f;
+  nesting_init(&it->nest, sizeof(struct riff_file_header_chunk_s), f->size);
+  it->nest.ds64 = f->ds64;
+  it->list_start_cb = list_start_cb;
+  it->list_end_cb   = list_end_cb;
+  it->window_offset = 0;
+  it->window_len    = 0;
+}
+
+//------------------------------------------------------------------
+riff_file_data_chunk_iterator_h riff_file_data_chunk_iterator_new(riff_file_h file_h,
+                                                                  riff_file_list_chunk_start_fn_t list_start_cb,
+                                                                  riff_file_list_chunk_end_fn_t   list_end_cb)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  if (f != NULL) {
+    struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)malloc(sizeof(struct riff_file_iterator_s));
+    if (it == NULL) {
+      diag_report(&f->diag, RIFF_FILE_ERROR_NO_MEMORY, errno, 0, NULL, 0);
+      return NULL;
+    }
+    iterator_init(it, f, list_start_cb, list_end_cb);
+    return it;
+  }
+  else {
+    diag_report(NULL, RIFF_FILE_ERROR_INVALID_HANDLE, 0, 0, NULL, 0);
+    return NULL;
+  }
+}
+
+//---------------------------------------------
+int32_t riff_file_data_chunk_iterator_set_flags(riff_file_data_chunk_iterator_h iter_h, uint32_t flags)
+{
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  it->nest.flags = flags;
+  return 0;
+}
+
+//---------------------------------------------
+int32_t riff_file_data_chunk_iterator_get_list_level(riff_file_data_chunk_iterator_h iter_h)
+{
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  return it->nest.list_level;
+}
+
+//---------------------------------------------
+// get chunk header at offset, reading it into window if file is not mapped
+//@return pointer to header, NULL on read error
+static const char* iterator_read_header(struct riff_file_iterator_s *it, uint64_t offset)
+{
+  struct riff_file_s *f = it->file;
+  if ((f->vaddr != NULL) && ((offset + sizeof(struct riff_file_list_chunk_s)) <= f->size)) {
+    return (const char*)f->vaddr + offset;
+  }
+  // header at end of file is read into window, never past end of mapping
+  if ((offset < it->window_offset) ||
+      ((offset + sizeof(struct riff_file_list_chunk_s)) > (it->window_offset + it->window_len))) {
+    int64_t len = file_read(f, offset, it->window, RIFF_FILE_HEADER_WINDOW_SIZE);
+    if (len < 0) {
+      diag_report(&it->nest.diag, RIFF_FILE_ERROR_READ, errno, offset, NULL, it->nest.list_level);
+      return NULL;
+    }
+    // header bytes past end of file read as zero
+    memset(it->window + len, 0, RIFF_FILE_HEADER_WINDOW_SIZE - len);
+    it->window_offset = offset;
+    it->window_len    = RIFF_FILE_HEADER_WINDOW_SIZE;
+  }
+  return it->window + (offset - it->window_offset);
+}
+
+//------------------------------------------------------------------
+// step to next data chunk, handling LIST and INFO headers on the way,
+// with lists set LIST start and end are returned as descriptors too,
+// always inlined so lists is constant in each caller and batch loop stays tight
+//@return 1 if chunk found, 0 on end of file, -1 on read error
+__attribute__((always_inline))
+static inline int32_t iterator_step(struct riff_file_iterator_s *it, struct riff_file_chunk_desc_s *desc, bool lists)
+{
+  // loop over LIST and INFO headers until next data chunk is found
+  for (;;) {
+    if (nesting_list_done(&it->nest)) {
+      // list done
+      if (it->list_end_cb != NULL) {
+        it->list_end_cb(it, it->nest.list_level);
+      }
+      RIFF_FILE_PROBE3(list_end, it->file, it->nest.list_end[it->nest.list_level], it->nest.list_level);
+      it->nest.list_level--;
+      if (lists) {
+        desc->offset = it->nest.list_end[it->nest.list_level + 1];
+        desc->size   = 0;
+        memcpy(desc->id, RIFF_FILE_TYPE_LIST_MAGIC, 4);
+        desc->level  = it->nest.list_level;
+        desc->kind   = RIFF_FILE_CHUNK_LIST_END;
+        return 1;
+      }
+      continue;
+    }
+
+    // check if all file done
+    if (nesting_eof(&it->nest)) {
+      // end of file, no more data to read
+      return 0;
+    }
+
+    uint64_t offset = it->nest.offset;
+    const char *cur_addr = iterator_read_header(it, offset);
+    if (cur_addr == NULL) {
+      return -1;
+    }
+
+    switch (nesting_consume_header(&it->nest, cur_addr)) {
+    case RIFF_FILE_HEADER_LIST:
+      {
+        const struct riff_file_list_chunk_s *list = (const struct riff_file_list_chunk_s *)cur_addr;
+        RIFF_FILE_PROBE5(list_start, it->file, offset, riff_file_fourcc(list->type), it->nest.size,
+                         it->nest.list_level);
+        if (it->list_start_cb != NULL) {
+          it->list_start_cb(it, it->nest.list_level, list->id, (size_t)it->nest.size, list->type);
+        }
+        if (lists) {
+          desc->offset = offset;
+          desc->size   = it->nest.size;
+          memcpy(desc->id, list->type, 4);
+          desc->level  = it->nest.list_level - 1;
+          desc->kind   = RIFF_FILE_CHUNK_LIST_START;
+          return 1;
+        }
+      }
+      break;
+    case RIFF_FILE_HEADER_INFO:
+      break;
+    case RIFF_FILE_HEADER_ERROR:
+      return -1;
+    default:
+      {
+        const struct riff_file_data_subchunk_s *subchunk = (const struct riff_file_data_subchunk_s *)cur_addr;
+        RIFF_FILE_PROBE4(chunk, it->file, offset, riff_file_fourcc(subchunk->id), it->nest.size);
+        desc->offset = offset;
+        desc->size   = it->nest.size;
+        memcpy(desc->id, subchunk->id, 4);
+        desc->level  = it->nest.list_level;
+        desc->kind   = RIFF_FILE_CHUNK_DATA;
+      }
+      return 1;
+    }
+  }
+}
+
+//------------------------------------------------------------------
+struct riff_file_data_subchunk_s* riff_file_data_chunk_iterator_next(riff_file_data_chunk_iterator_h iter_h)
+{
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  struct riff_file_chunk_desc_s desc;
+
+  if (it->file->vaddr == NULL) {
+    diag_report(&it->nest.diag, RIFF_FILE_ERROR_NOT_MAPPED, 0, it->nest.offset, NULL, it->nest.list_level);
+    return NULL;
+  }
+  RIFF_FILE_STAT_TIME_START();
+  int32_t res = iterator_step(it, &desc, false);
+  RIFF_FILE_STAT_TIME_END(&it->nest);
+  if (res <= 0) {
+    return NULL;
+  }
+  return (struct riff_file_data_subchunk_s *)((char*)it->file->vaddr + desc.offset);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_data_chunk_iterator_next_view(riff_file_data_chunk_iterator_h iter_h,
+                                                struct riff_file_chunk_view_s *view)
+{
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  struct riff_file_chunk_desc_s desc;
+
+  RIFF_FILE_STAT_TIME_START();
+  int32_t res = iterator_step(it, &desc, false);
+  RIFF_FILE_STAT_TIME_END(&it->nest);
+  if (res <= 0) {
+    return res;
+  }
+  return riff_file_get_chunk_view(it->file, &desc, view);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_data_chunk_iterator_next_desc(riff_file_data_chunk_iterator_h iter_h,
+                                                struct riff_file_chunk_desc_s *desc)
+{
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  RIFF_FILE_STAT_TIME_START();
+  int32_t res = iterator_step(it, desc, false);
+  RIFF_FILE_STAT_TIME_END(&it->nest);
+  return res;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_data_chunk_iterator_next_batch(riff_file_data_chunk_iterator_h iter_h,
+                                                 struct riff_file_chunk_desc_s *descs, size_t max)
+{
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  if (max > INT32_MAX) {
+    max = INT32_MAX;
+  }
+  size_t n = 0;
+  int32_t res = 1;
+  RIFF_FILE_STAT_TIME_START();
+  while (n < max) {
+    res = iterator_step(it, &descs[n], true);
+    if (res <= 0) {
+      break;
+    }
+    n++;
+  }
+  RIFF_FILE_STAT_TIME_END(&it->nest);
+  // read error is reported on next call if descriptors were filled
+  if ((res < 0) && (n == 0)) {
+    return -1;
+  }
+  return (int32_t)n;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_data_chunk_iterator_get_stats(riff_file_data_chunk_iterator_h iter_h,
+                                                struct riff_file_iterator_stats_s *stats)
+{
+#ifdef RIFF_FILE_STATS
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  *stats = it->nest.stats;
+  return 0;
+#else
+  memset(stats, 0, sizeof(struct riff_file_iterator_stats_s));
+  return -1;
+#endif
+}
+
+//------------------------------------------------------------------
+enum riff_file_error_e riff_file_data_chunk_iterator_get_error(riff_file_data_chunk_iterator_h iter_h,
+                                                               struct riff_file_diag_s *diag)
+{
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  return diag_get(&it->nest.diag, diag);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_data_chunk_iterator_delete(riff_file_data_chunk_iterator_h iter_h)
+{
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)iter_h;
+  nesting_release(&it->nest);
+  free(it);
+  return 0;
+}
+
+//------------------------------------------------------------------
+riff_file_stream_h riff_file_stream_new(const char type[4],
+                                        const struct riff_file_stream_callbacks_s *callbacks,
+                                        void *user)
+{
+  struct riff_file_stream_s *st = (struct riff_file_stream_s *)malloc(sizeof(struct riff_file_stream_s));
+  if (st == NULL) {
+    diag_report(NULL, RIFF_FILE_ERROR_NO_MEMORY, errno, 0, NULL, 0);
+    return NULL;
+  }
+  memcpy(st->type, type, 4);
+  st->cb        = *callbacks;
+  st->user      = user;
+  st->state     = RIFF_FILE_STREAM_FILE_HEADER;
+  st->pos       = 0;
+  st->remaining = 0;
+  st->pad       = 0;
+  st->hdr_len   = 0;
+  st->rf64      = false;
+  st->ds64_collect = false;
+  st->ds64_len  = 0;
+  // stream end is set from file header
+  nesting_init(&st->nest, sizeof(struct riff_file_header_chunk_s), UINT64_MAX);
+  return st;
+}
+
+//------------------------------------------------------------------
+// collect header bytes from buffer
+//@return true when header holds len bytes
+static bool stream_fill_header(struct riff_file_stream_s *st, uint32_t len,
+                               const uint8_t **p, const uint8_t *end)
+{
+  if (st->hdr_len >= len) {
+    return true;
+  }
+  size_t n = len - st->hdr_len;
+  if (n > (size_t)(end - *p)) {
+    n = end - *p;
+  }
+  memcpy(st->hdr + st->hdr_len, *p, n);
+  st->hdr_len += n;
+  *p += n;
+  return st->hdr_len == len;
+}
+
+//------------------------------------------------------------------
+static void stream_file_header(struct riff_file_stream_s *st)
+{
+  const struct riff_file_header_chunk_s *header = (const struct riff_file_header_chunk_s *)st->hdr;
+  st->rf64 = file_magic_rf64(header->id);
+  if ((riff_file_fourcc(header->id) != RIFF_FILE_FOURCC_RIFF) && !st->rf64) {
+    diag_report(&st->nest.diag, RIFF_FILE_ERROR_HEADER, 0, 0, header->id, 0);
+    st->state = RIFF_FILE_STREAM_ERROR;
+    return;
+  }
+  if (memcmp(header->format, st->type, 4) != 0) {
+    diag_report(&st->nest.diag, RIFF_FILE_ERROR_HEADER, 0, 0, header->format, 0);
+    st->state = RIFF_FILE_STREAM_ERROR;
+    return;
+  }
+  // streaming writers may not know size up front, then parse until end of stream
+  uint64_t end = (uint64_t)header->size + 8;
+  if ((header->size == 0) || (header->size == UINT32_MAX)) {
+    end = UINT64_MAX;
+  }
+  st->nest.list_end[0] = end;
+  st->pos     = sizeof(struct riff_file_header_chunk_s);
+  st->hdr_len = 0;
+  st->state   = RIFF_FILE_STREAM_CHUNK_HEADER;
+}
+
+//------------------------------------------------------------------
+// after chunk payload, skip its pad byte if any before next header
+static void stream_skip_pad(struct riff_file_stream_s *st)
+{
+  st->state = RIFF_FILE_STREAM_CHUNK_HEADER;
+  if (st->pad > 0) {
+    st->remaining = st->pad;
+    st->pad = 0;
+    st->state = RIFF_FILE_STREAM_SKIP;
+  }
+}
+
+//------------------------------------------------------------------
+static void stream_chunk_header(struct riff_file_stream_s *st)
+{
+  uint64_t offset = st->nest.offset;
+  enum riff_file_header_kind_e kind = nesting_consume_header(&st->nest, st->hdr);
+  if (kind == RIFF_FILE_HEADER_ERROR) {
+    st->state = RIFF_FILE_STREAM_ERROR;
+    return;
+  }
+  st->pos += st->hdr_len;
+  st->hdr_len = 0;
+  if (st->nest.offset < st->pos) {
+    // list size smaller than its type, stream can not go back
+    diag_report(&st->nest.diag, RIFF_FILE_ERROR_CHUNK_SIZE, 0, offset, st->hdr, st->nest.list_level);
+    st->state = RIFF_FILE_STREAM_ERROR;
+    return;
+  }
+  st->remaining = st->nest.offset - st->pos;
+
+  if (kind == RIFF_FILE_HEADER_LIST) {
+    const struct riff_file_list_chunk_s *list = (const struct riff_file_list_chunk_s *)st->hdr;
+    if (st->cb.list_start != NULL) {
+      st->cb.list_start(st->user, st->nest.list_level, list->id, (size_t)st->nest.size, list->type);
+    }
+    if (st->remaining > 0) {
+      st->state = RIFF_FILE_STREAM_SKIP;
+    }
+  }
+  else if (kind == RIFF_FILE_HEADER_DATA) {
+    const struct riff_file_data_subchunk_s *subchunk = (const struct riff_file_data_subchunk_s *)st->hdr;
+    // ds64 is collected so later chunks get their 64 bit sizes
+    st->ds64_collect = st->rf64 && (st->nest.list_level == 0) &&
+                       (riff_file_fourcc(subchunk->id) == RIFF_FILE_FOURCC_DS64);
+    st->ds64_len = 0;
+    // pad byte is not payload
+    st->pad = (uint32_t)(st->remaining - st->nest.size);
+    st->remaining = st->nest.size;
+    if (st->cb.chunk_start != NULL) {
+      st->cb.chunk_start(st->user, st->nest.list_level, subchunk->id, st->nest.size, offset);
+    }
+    if (st->remaining > 0) {
+      st->state = RIFF_FILE_STREAM_PAYLOAD;
+    }
+    else {
+      if (st->cb.chunk_end != NULL) {
+        st->cb.chunk_end(st->user);
+      }
+      stream_skip_pad(st);
+    }
+  }
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_stream_push(riff_file_stream_h stream_h, const void *buf, size_t len)
+{
+  struct riff_file_stream_s *st = (struct riff_file_stream_s *)stream_h;
+  const uint8_t *p   = (const uint8_t *)buf;
+  const uint8_t *end = p + len;
+
+  for (;;) {
+    switch (st->state) {
+    case RIFF_FILE_STREAM_FILE_HEADER:
+      if (!stream_fill_header(st, sizeof(struct riff_file_header_chunk_s), &p, end)) {
+        return 0;
+      }
+      stream_file_header(st);
+      break;
+
+    case RIFF_FILE_STREAM_CHUNK_HEADER:
+      while (nesting_list_done(&st->nest)) {
+        // list done
+        if (st->cb.list_end != NULL) {
+          st->cb.list_end(st->user, st->nest.list_level);
+        }
+        st->nest.list_level--;
+      }
+      if (nesting_eof(&st->nest)) {
+        st->state = RIFF_FILE_STREAM_DONE;
+        break;
+      }
+      // chunk id tells how large header is
+      if (!stream_fill_header(st, 4, &p, end) ||
+          !stream_fill_header(st, nesting_header_size(st->hdr), &p, end)) {
+        return 0;
+      }
+      stream_chunk_header(st);
+      break;
+
+    case RIFF_FILE_STREAM_PAYLOAD:
+    case RIFF_FILE_STREAM_SKIP:
+      if (p == end) {
+        return 0;
+      }
+      {
+        size_t n = end - p;
+        if (n > st->remaining) {
+          n = (size_t)st->remaining;
+        }
+        // payload is passed straight from caller buffer
+        if ((st->state == RIFF_FILE_STREAM_PAYLOAD) && (st->cb.chunk_data != NULL)) {
+          st->cb.chunk_data(st->user, p, n);
+        }
+        if (st->ds64_collect) {
+          size_t c = sizeof(st->ds64_raw) - st->ds64_len;
+          if (c > n) {
+            c = n;
+          }
+          memcpy(st->ds64_raw + st->ds64_len, p, c);
+          st->ds64_len += c;
+        }
+        p += n;
+        st->pos += n;
+        st->remaining -= n;
+      }
+      if (st->remaining == 0) {
+        if (st->ds64_collect && (ds64_decode(&st->ds64, st->ds64_raw, st->ds64_len) == 0)) {
+          st->nest.ds64 = &st->ds64;
+        }
+        st->ds64_collect = false;
+        if (st->state == RIFF_FILE_STREAM_PAYLOAD) {
+          if (st->cb.chunk_end != NULL) {
+            st->cb.chunk_end(st->user);
+          }
+          stream_skip_pad(st);
+        }
+        else {
+          st->state = RIFF_FILE_STREAM_CHUNK_HEADER;
+        }
+      }
+      break;
+
+    case RIFF_FILE_STREAM_DONE:
+      // trailing bytes after RIFF chunk are ignored
+      return 0;
+
+    default:
+      return -1;
+    }
+  }
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_stream_finish(riff_file_stream_h stream_h)
+{
+  struct riff_file_stream_s *st = (struct riff_file_stream_s *)stream_h;
+  if (st->state == RIFF_FILE_STREAM_DONE) {
+    return 0;
+  }
+  if ((st->state != RIFF_FILE_STREAM_CHUNK_HEADER) || (st->hdr_len != 0)) {
+    // stopped inside header or payload
+    st->state = RIFF_FILE_STREAM_ERROR;
+    return -1;
+  }
+  // close lists still open
+  bool truncated = (st->nest.list_end[0] != UINT64_MAX);
+  while (st->nest.list_level > 0) {
+    if (st->cb.list_end != NULL) {
+      st->cb.list_end(st->user, st->nest.list_level);
+    }
+    st->nest.list_level--;
+  }
+  st->state = truncated ? RIFF_FILE_STREAM_ERROR : RIFF_FILE_STREAM_DONE;
+  return truncated ? -1 : 0;
+}
+
+//------------------------------------------------------------------
+enum riff_file_error_e riff_file_stream_get_error(riff_file_stream_h stream_h, struct riff_file_diag_s *diag)
+{
+  struct riff_file_stream_s *st = (struct riff_file_stream_s *)stream_h;
+  return diag_get(&st->nest.diag, diag);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_stream_delete(riff_file_stream_h stream_h)
+{
+  struct riff_file_stream_s *st = (struct riff_file_stream_s *)stream_h;
+  nesting_release(&st->nest);
+  free(st);
+  return 0;
+}
+
+//------------------------------------------------------------------
+static struct riff_file_index_entry_s* index_add_entry(struct riff_file_index_s *idx)
+{
+  if (idx->count == idx->capacity) {
+    size_t capacity = idx->capacity * 2;
+    struct riff_file_index_entry_s *entries =
+      (struct riff_file_index_entry_s *)realloc(idx->entries, capacity * sizeof(struct riff_file_index_entry_s));
+    if (entries == NULL) {
+      return NULL;
+    }
+    idx->entries  = entries;
+    idx->capacity = capacity;
+  }
+  return &idx->entries[idx->count++];
+}
+
+//------------------------------------------------------------------
+// parent of new entry at level, LIST entries still open are found through parent
+// links of innermost open LIST, so no per level state is needed for any depth
+static int32_t index_open_parent(struct riff_file_index_s *idx, int32_t level)
+{
+  int32_t p = idx->open_list;
+  while ((p >= 0) && (idx->entries[p].level >= level)) {
+    p = idx->entries[p].parent;
+  }
+  idx->open_list = p;
+  return p;
+}
+
+//------------------------------------------------------------------
+static int32_t index_init(struct riff_file_index_s *idx, struct riff_file_s *f)
+{
+  idx->file      = f;
+  idx->map       = NULL;
+  idx->map_size  = 0;
+  idx->buckets   = NULL;
+  idx->next      = NULL;
+  idx->count     = 0;
+  idx->capacity  = RIFF_FILE_INDEX_INITIAL_ENTRIES;
+  idx->entries   = (struct riff_file_index_entry_s *)malloc(idx->capacity * sizeof(struct riff_file_index_entry_s));
+  idx->open_list = -1;
+  return (idx->entries != NULL) ? 0 : -1;
+}
+
+//------------------------------------------------------------------
+// add chunks and LIST chunks to index until walk is back at top level at or past stop,
+// LIST start and end are stepped one at a time so walk never passes stop within a step
+//@return 1 if stop reached, 0 at end of file, -1 on error, capacity is 0 if out of memory
+static int32_t index_walk(struct riff_file_index_s *idx, struct riff_file_iterator_s *it, uint64_t stop)
+{
+  struct riff_file_chunk_desc_s desc;
+  for (;;) {
+    if ((it->nest.list_level == 0) && (it->nest.offset >= stop)) {
+      return 1;
+    }
+    int32_t res = iterator_step(it, &desc, true);
+    if (res <= 0) {
+      return res;
+    }
+    if (desc.kind == RIFF_FILE_CHUNK_LIST_END) {
+      continue;
+    }
+    struct riff_file_index_entry_s *e = index_add_entry(idx);
+    if (e == NULL) {
+      idx->capacity = 0;
+      return -1;
+    }
+    e->offset = desc.offset;
+    e->size   = desc.size;
+    if (desc.kind == RIFF_FILE_CHUNK_LIST_START) {
+      memcpy(e->id, RIFF_FILE_TYPE_LIST_MAGIC, 4);
+      memcpy(e->type, desc.id, 4);
+    }
+    else {
+      memcpy(e->id, desc.id, 4);
+      memset(e->type, 0, 4);
+    }
+    e->level  = desc.level;
+    e->parent = index_open_parent(idx, desc.level);
+    if (desc.kind == RIFF_FILE_CHUNK_LIST_START) {
+      idx->open_list = (int32_t)(idx->count - 1);
+    }
+  }
+}
+
+//------------------------------------------------------------------
+// append entries walked by parallel worker from first entry after a top level sync point,
+// nothing after that point links to entries before it, so parent links are just moved
+//@return 0 on success, -1 if out of memory
+static int32_t index_append(struct riff_file_index_s *idx, const struct riff_file_index_s *part, size_t first)
+{
+  size_t count = part->count - first;
+  if ((idx->count + count) > idx->capacity) {
+    size_t capacity = idx->capacity * 2;
+    if (capacity < (idx->count + count)) {
+      capacity = idx->count + count;
+    }
+    struct riff_file_index_entry_s *entries =
+      (struct riff_file_index_entry_s *)realloc(idx->entries, capacity * sizeof(struct riff_file_index_entry_s));
+    if (entries == NULL) {
+      idx->capacity = 0;
+      return -1;
+    }
+    idx->entries  = entries;
+    idx->capacity = capacity;
+  }
+  int32_t base = (int32_t)idx->count - (int32_t)first;
+  size_t i;
+  for (i = first; i < part->count; i++) {
+    struct riff_file_index_entry_s *e = &idx->entries[idx->count++];
+    *e = part->entries[i];
+    if (e->parent >= 0) {
+      e->parent += base;
+    }
+  }
+  // region walk stopped at top level, no LIST is open
+  idx->open_list = -1;
+  return 0;
+}
+
+//------------------------------------------------------------------
+// check if offset holds plausible top level chunk header, ascii id and size inside file
+static bool chain_header_plausible(const struct riff_file_s *f, uint64_t offset, uint64_t *next)
+{
+  if ((offset + sizeof(struct riff_file_data_subchunk_s)) > f->size) {
+    return false;
+  }
+  const char *hdr = (const char*)f->vaddr + offset;
+  int i;
+  for (i = 0; i < 4; i++) {
+    if ((hdr[i] < 0x20) || (hdr[i] > 0x7e)) {
+      return false;
+    }
+  }
+  // same stepping as iterator at top level
+  if (riff_file_fourcc(hdr) == RIFF_FILE_FOURCC_INFO) {
+    *next = offset + 4;
+    return true;
+  }
+  uint32_t size;
+  memcpy(&size, hdr + 4, 4);
+  if (size > (f->size - offset - 8)) {
+    return false;
+  }
+  *next = offset + 8 + size + (size & 1);
+  return true;
+}
+
+//------------------------------------------------------------------
+// find offset in region starting a run of plausible top level headers,
+// each start is only followed for a few headers and few starts are tried, so search is bounded
+static bool chain_find_start(const struct riff_file_s *f, uint64_t begin, uint64_t end, uint64_t *start)
+{
+  uint64_t limit = begin + RIFF_FILE_PARALLEL_RESYNC_LIMIT;
+  if (limit > end) {
+    limit = end;
+  }
+  uint64_t s;
+  for (s = begin; s < limit; s++) {
+    uint64_t offset = s;
+    uint64_t next;
+    int32_t n = 0;
+    while ((n < RIFF_FILE_PARALLEL_CHAIN_CONFIRM) && (offset < end) && chain_header_plausible(f, offset, &next)) {
+      offset = next;
+      n++;
+    }
+    if ((n == RIFF_FILE_PARALLEL_CHAIN_CONFIRM) || ((n > 0) && (offset >= end))) {
+      *start = s;
+      return true;
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------
+static bool chain_add_sync(struct riff_file_chain_s *c, uint64_t offset)
+{
+  if (c->sync_count == c->sync_capacity) {
+    size_t capacity = (c->sync_capacity == 0) ? RIFF_FILE_INDEX_INITIAL_ENTRIES : (c->sync_capacity * 2);
+    struct riff_file_chain_sync_s *sync =
+      (struct riff_file_chain_sync_s *)realloc(c->sync, capacity * sizeof(struct riff_file_chain_sync_s));
+    if (sync == NULL) {
+      return false;
+    }
+    c->sync          = sync;
+    c->sync_capacity = capacity;
+  }
+  c->sync[c->sync_count].offset = offset;
+  c->sync[c->sync_count].entry  = c->part.count;
+  c->sync_count++;
+  return true;
+}
+
+//------------------------------------------------------------------
+// walk region from first plausible start into index entries of its own,
+// one top level chunk at a time so sync points can be recorded between them
+static void* chain_scan(void *arg)
+{
+  struct riff_file_chain_s *c = (struct riff_file_chain_s *)arg;
+  if (!chain_find_start(c->file, c->begin, c->end, &c->start)) {
+    return NULL;
+  }
+  struct riff_file_iterator_s *it = (struct riff_file_iterator_s *)malloc(sizeof(struct riff_file_iterator_s));
+  if (it == NULL) {
+    return NULL;
+  }
+  if (index_init(&c->part, c->file) != 0) {
+    free(it);
+    return NULL;
+  }
+  // start may be wrong, diagnostics are kept and reported only if entries are used
+  diag_quiet = true;
+  iterator_init(it, c->file, NULL, NULL);
+  it->nest.offset = c->start;
+  int32_t res = 1;
+  uint64_t chunks = 0;
+  while ((res > 0) && (it->nest.offset < c->end)) {
+    if (((chunks++ % RIFF_FILE_PARALLEL_SYNC_INTERVAL) == 0) && !chain_add_sync(c, it->nest.offset)) {
+      res = -1;
+      break;
+    }
+    res = index_walk(&c->part, it, it->nest.offset + 1);
+  }
+  if (res >= 0) {
+    c->stop  = it->nest.offset;
+    c->diag  = it->nest.diag;
+    c->found = true;
+  }
+  nesting_release(&it->nest);
+  free(it);
+  diag_quiet = false;
+  return NULL;
+}
+
+//------------------------------------------------------------------
+static void chains_delete(struct riff_file_chains_s *chains)
+{
+  int32_t i;
+  for (i = 0; i < chains->count; i++) {
+    free(chains->chain[i].part.entries);
+    free(chains->chain[i].sync);
+  }
+  free(chains->chain);
+}
+
+//------------------------------------------------------------------
+// split top level of file in regions and walk them on separate threads
+static int32_t chains_scan(struct riff_file_s *f, int32_t threads, struct riff_file_chains_s *chains)
+{
+  chains->chain = (struct riff_file_chain_s *)calloc(threads, sizeof(struct riff_file_chain_s));
+  if (chains->chain == NULL) {
+    return -1;
+  }
+  chains->count = threads;
+
+  uint64_t begin = sizeof(struct riff_file_header_chunk_s);
+  uint64_t len   = f->size - begin;
+  int32_t i;
+  for (i = 0; i < threads; i++) {
+    struct riff_file_chain_s *c = &chains->chain[i];
+    c->file  = f;
+    c->begin = begin + (len * i) / threads;
+    c->end   = begin + (len * (i + 1)) / threads;
+  }
+
+  // current thread walks first region
+  int32_t started = 1;
+  for (i = 1; i < threads; i++) {
+    if (pthread_create(&chains->chain[i].thread, NULL, chain_scan, &chains->chain[i]) != 0) {
+      break;
+    }
+    started++;
+  }
+  chain_scan(&chains->chain[0]);
+  // regions not started are left to sequential walk
+  for (i = 1; i < started; i++) {
+    pthread_join(chains->chain[i].thread, NULL);
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+// take entries of region walked in parallel if sequential walk lands on one of its sync points,
+// both walks are at top level there so they are identical from that point on
+//@return 1 if walk goes on, 0 at end of file, -1 on error
+static int32_t index_join(struct riff_file_index_s *idx, struct riff_file_iterator_s *it,
+                          const struct riff_file_chain_s *c)
+{
+  size_t j = 0;
+  while (j < c->sync_count) {
+    int32_t res = index_walk(idx, it, c->sync[j].offset);
+    if (res <= 0) {
+      return res;
+    }
+    if (it->nest.offset == c->sync[j].offset) {
+      if (index_append(idx, &c->part, c->sync[j].entry) != 0) {
+        return -1;
+      }
+      it->nest.offset = c->stop;
+      if ((c->diag.error != RIFF_FILE_ERROR_NONE) && (c->diag.offset >= c->sync[j].offset)) {
+        diag_report(&it->nest.diag, c->diag.error, c->diag.sys_errno, c->diag.offset, c->diag.id, c->diag.level);
+      }
+      return 1;
+    }
+    // walked past sync point, try next one
+    while ((j < c->sync_count) && (c->sync[j].offset < it->nest.offset)) {
+      j++;
+    }
+  }
+  // walks never met, region is walked sequentially
+  return 1;
+}
+
+//------------------------------------------------------------------
+// walk file into index, sequential walk takes entries of regions walked in parallel
+// whenever it joins one of them and goes on where that walk stopped
+static struct riff_file_index_s* index_build(struct riff_file_s *f, const struct riff_file_chains_s *chains)
+{
+  struct riff_file_index_s *idx = (struct riff_file_index_s *)malloc(sizeof(struct riff_file_index_s));
+  if (idx == NULL) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_NO_MEMORY, errno, 0, NULL, 0);
+    return NULL;
+  }
+  if (index_init(idx, f) != 0) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_NO_MEMORY, errno, 0, NULL, 0);
+    free(idx);
+    return NULL;
+  }
+
+  struct riff_file_iterator_s *it =
+    (struct riff_file_iterator_s *)riff_file_data_chunk_iterator_new(f, NULL, NULL);
+  if (it == NULL) {
+    free(idx->entries);
+    free(idx);
+    return NULL;
+  }
+
+  int32_t res = 1;
+  int32_t k;
+  for (k = 0; (chains != NULL) && (k < chains->count) && (res > 0); k++) {
+    const struct riff_file_chain_s *c = &chains->chain[k];
+    if (!c->found) {
+      continue;
+    }
+    res = index_join(idx, it, c);
+  }
+  if (res > 0) {
+    res = index_walk(idx, it, UINT64_MAX);
+  }
+  // errors and diagnostics of walk are kept on file, they were logged when they happened
+  if (it->nest.diag.error != RIFF_FILE_ERROR_NONE) {
+    f->diag = it->nest.diag;
+  }
+  riff_file_data_chunk_iterator_delete(it);
+
+  if (idx->capacity == 0) {
+    diag_report(&f->diag, RIFF_FILE_ERROR_NO_MEMORY, ENOMEM, 0, NULL, 0);
+    free(idx->entries);
+    free(idx);
+    return NULL;
+  }
+  if (res < 0) {
+    free(idx->entries);
+    free(idx);
+    return NULL;
+  }
+
+  // compact entries, index is not modified after build
+  if (idx->count > 0) {
+    struct riff_file_index_entry_s *entries =
+      (struct riff_file_index_entry_s *)realloc(idx->entries, idx->count * sizeof(struct riff_file_index_entry_s));
+    if (entries != NULL) {
+      idx->entries  = entries;
+      idx->capacity = idx->count;
+    }
+  }
+  return idx;
+}
+
+//------------------------------------------------------------------
+riff_file_index_h riff_file_index_get(riff_file_h file_h)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  if (f == NULL) {
+    return NULL;
+  }
+  if (f->index == NULL) {
+    f->index = index_build(f, NULL);
+    index_cache_store(f);
+  }
+  return f->index;
+}
+
+//------------------------------------------------------------------
+riff_file_index_h riff_file_index_get_parallel(riff_file_h file_h, int32_t threads)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  // scan for plausible headers can not see 64 bit sizes, RF64/BW64 is walked sequentially
+  if ((f == NULL) || (f->index != NULL) || (f->vaddr == NULL) || (f->ds64 != NULL)) {
+    return riff_file_index_get(file_h);
+  }
+  // threads can only win if each has a CPU and enough of file to walk, else walk sequentially
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus < 1) {
+    cpus = 1;
+  }
+  if ((threads <= 0) || (threads > cpus)) {
+    threads = (int32_t)((cpus < RIFF_FILE_PARALLEL_MAX_THREADS) ? cpus : RIFF_FILE_PARALLEL_MAX_THREADS);
+  }
+  if (threads > RIFF_FILE_PARALLEL_MAX_THREADS) {
+    threads = RIFF_FILE_PARALLEL_MAX_THREADS;
+  }
+  if ((uint64_t)threads > (f->size / RIFF_FILE_PARALLEL_MIN_REGION)) {
+    threads = (int32_t)(f->size / RIFF_FILE_PARALLEL_MIN_REGION);
+  }
+  if (threads <= 1) {
+    return riff_file_index_get(file_h);
+  }
+
+  // regions are walked in parallel from guessed start offsets, index build
+  // only takes a region where the real chain from the file header meets its start
+  struct riff_file_chains_s chains;
+  if (chains_scan(f, threads, &chains) != 0) {
+    return riff_file_index_get(file_h);
+  }
+  f->index = index_build(f, &chains);
+  chains_delete(&chains);
+  index_cache_store(f);
+  return f->index;
+}
+
+//------------------------------------------------------------------
+size_t riff_file_index_get_count(riff_file_index_h index_h)
+{
+  struct riff_file_index_s *idx = (struct riff_file_index_s *)index_h;
+  return idx->count;
+}
+
+//------------------------------------------------------------------
+const struct riff_file_index_entry_s* riff_file_index_get_entry(riff_file_index_h index_h, size_t n)
+{
+  struct riff_file_index_s *idx = (struct riff_file_index_s *)index_h;
+  if (n >= idx->count) {
+    return NULL;
+  }
+  return &idx->entries[n];
+}
+
+//------------------------------------------------------------------
+struct riff_file_data_subchunk_s* riff_file_index_get_chunk(riff_file_index_h index_h, size_t n)
+{
+  struct riff_file_index_s *idx = (struct riff_file_index_s *)index_h;
+  if ((n >= idx->count) || (idx->file->vaddr == NULL)) {
+    return NULL;
+  }
+  // header must be inside mapping, as for riff_file_get_chunk_view
+  uint64_t offset = idx->entries[n].offset;
+  if ((offset > idx->file->size) || (sizeof(struct riff_file_data_subchunk_s) > (idx->file->size - offset))) {
+    return NULL;
+  }
+  return (struct riff_file_data_subchunk_s *)((char*)idx->file->vaddr + offset);
+}
+
+//------------------------------------------------------------------
+static uint32_t index_entry_key(const struct riff_file_index_entry_s *e)
+{
+  if (riff_file_fourcc(e->id) == RIFF_FILE_FOURCC_LIST) {
+    return riff_file_fourcc(e->type);
+  }
+  return riff_file_fourcc(e->id);
+}
+
+//------------------------------------------------------------------
+static struct riff_file_index_bucket_s* index_hash_lookup(struct riff_file_index_s *idx, uint32_t key)
+{
+  uint32_t mask = (1u << (32 - idx->bucket_shift)) - 1;
+  uint32_t i = (key * RIFF_FILE_INDEX_HASH_MULT) >> idx->bucket_shift;
+  // table is never full, probing always ends at matching or empty bucket
+  while ((idx->buckets[i].first >= 0) && (idx->buckets[i].id != key)) {
+    i = (i + 1) & mask;
+  }
+  return &idx->buckets[i];
+}
+
+//------------------------------------------------------------------
+static int32_t index_hash_build(struct riff_file_index_s *idx)
+{
+  // at least twice as many buckets as entries keeps probe sequences short
+  uint32_t bits = 4;
+  while (((size_t)1 << bits) < (idx->count * 2)) {
+    bits++;
+  }
+  size_t nbuckets = (size_t)1 << bits;
+
+  idx->buckets = (struct riff_file_index_bucket_s *)malloc(nbuckets * sizeof(struct riff_file_index_bucket_s));
+  idx->next    = (int32_t *)malloc((idx->count + 1) * sizeof(int32_t));
+  if ((idx->buckets == NULL) || (idx->next == NULL)) {
+    diag_report(&idx->file->diag, RIFF_FILE_ERROR_NO_MEMORY, ENOMEM, 0, NULL, 0);
+    free(idx->buckets);
+    free(idx->next);
+    idx->buckets = NULL;
+    idx->next    = NULL;
+    return -1;
+  }
+  idx->bucket_shift = 32 - bits;
+
+  size_t i;
+  for (i = 0; i < nbuckets; i++) {
+    idx->buckets[i].first = -1;
+  }
+  for (i = 0; i < idx->count; i++) {
+    uint32_t key = index_entry_key(&idx->entries[i]);
+    struct riff_file_index_bucket_s *b = index_hash_lookup(idx, key);
+    if (b->first < 0) {
+      b->id    = key;
+      b->first = (int32_t)i;
+      b->count = 0;
+    }
+    else {
+      idx->next[b->last] = (int32_t)i;
+    }
+    b->last = (int32_t)i;
+    b->count++;
+    idx->next[i] = -1;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+static struct riff_file_index_bucket_s* index_find_bucket(riff_file_index_h index_h, uint32_t fourcc)
+{
+  struct riff_file_index_s *idx = (struct riff_file_index_s *)index_h;
+  if ((idx->buckets == NULL) && (index_hash_build(idx) != 0)) {
+    return NULL;
+  }
+  struct riff_file_index_bucket_s *b = index_hash_lookup(idx, fourcc);
+  if (b->first < 0) {
+    return NULL;
+  }
+  return b;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_index_find(riff_file_index_h index_h, const char id[4])
+{
+  return riff_file_index_find_fourcc(index_h, riff_file_fourcc(id));
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_index_find_fourcc(riff_file_index_h index_h, uint32_t fourcc)
+{
+  struct riff_file_index_bucket_s *b = index_find_bucket(index_h, fourcc);
+  if (b == NULL) {
+    return -1;
+  }
+  return b->first;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_index_find_next(riff_file_index_h index_h, int32_t n)
+{
+  struct riff_file_index_s *idx = (struct riff_file_index_s *)index_h;
+  if ((idx->next == NULL) || (n < 0) || ((size_t)n >= idx->count)) {
+    return -1;
+  }
+  return idx->next[n];
+}
+
+//------------------------------------------------------------------
+size_t riff_file_index_find_count(riff_file_index_h index_h, const char id[4])
+{
+  struct riff_file_index_bucket_s *b = index_find_bucket(index_h, riff_file_fourcc(id));
+  if (b == NULL) {
+    return 0;
+  }
+  return b->count;
+}
+
+//------------------------------------------------------------------
+uint64_t riff_file_get_size(riff_file_h file_h)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  return f->size;
+}
+
+//------------------------------------------------------------------
+void riff_file_get_format(riff_file_h file_h, char format[4])
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  memcpy(format, f->format, 4);
+}
+
+//------------------------------------------------------------------
+enum riff_file_backend_e riff_file_get_backend(riff_file_h file_h)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  return f->io->backend;
+}
+
+//------------------------------------------------------------------
+struct riff_file_data_subchunk_s* riff_file_get_chunk(riff_file_h file_h, const struct riff_file_chunk_desc_s *desc)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  if ((f->vaddr == NULL) || (desc->offset >= f->size)) {
+    return NULL;
+  }
+  return (struct riff_file_data_subchunk_s *)((char*)f->vaddr + desc->offset);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_get_chunk_view(riff_file_h file_h, const struct riff_file_chunk_desc_s *desc,
+                                 struct riff_file_chunk_view_s *view)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  if (f->vaddr == NULL) {
+    return -1;
+  }
+  // header and whole payload must be inside mapping
+  uint64_t header_size = sizeof(struct riff_file_data_subchunk_s);
+  if ((desc->offset > f->size) ||
+      (header_size > (f->size - desc->offset)) ||
+      (desc->size > (f->size - desc->offset - header_size))) {
+    return -1;
+  }
+  view->data   = (const uint8_t *)f->vaddr + desc->offset + header_size;
+  view->size   = desc->size;
+  view->offset = desc->offset;
+  memcpy(view->id, desc->id, 4);
+  view->level  = desc->level;
+  return 1;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_read(riff_file_h file_h, uint64_t offset, void *buf, size_t len)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  if ((offset > f->size) || (len > (f->size - offset))) {
+    return -1;
+  }
+  if (file_read(f, offset, buf, len) != (int64_t)len) {
+    return -1;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_read_batch(riff_file_h file_h, struct riff_file_read_req_s *reqs, size_t n)
+{
+  struct riff_file_s *f = (struct riff_file_s *)file_h;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if ((reqs[i].offset > f->size) || (reqs[i].len > (f->size - reqs[i].offset))) {
+      return -1;
+    }
+  }
+  if (f->io->read(f, reqs, n) != 0) {
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    if (reqs[i].result != (int64_t)reqs[i].len) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_close(riff_file_h file_h)
+{
+  RIFF_FILE_PROBE1(close, file_h);
+  file_release((struct riff_file_s *)file_h);
   return 0;
 }
@@ -11,6 +11,11 @@
  * More info on RIFF at
  * https://en.wikipedia.org/wiki/Resource_Interchange_File_Format
  *
+ * Odd sized chunks are followed by a pad byte, which iterator, stream parser
+ * and index step over. Earlier versions did not, so files written without pad
+ * bytes after odd sized chunks now parse differently, only a pad missing at
+ * end of a LIST is tolerated.
+ *
  * This file is in the public domain.
  * You can do whatever you want with it.
  *
@@ -19,8 +24,43 @@
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
  */
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// chunk id as 32 bit integer, first character in lowest byte as stored in file,
+// constant expression usable as case label, e.g. RIFF_FILE_FOURCC('f', 'm', 't', ' ')
+#define RIFF_FILE_FOURCC(a, b, c, d)                              \
+  ((uint32_t)(uint8_t)(a)         | ((uint32_t)(uint8_t)(b) << 8) | \
+   ((uint32_t)(uint8_t)(c) << 16) | ((uint32_t)(uint8_t)(d) << 24))
+
+// common chunk ids and form types
+#define RIFF_FILE_FOURCC_RIFF RIFF_FILE_FOURCC('R', 'I', 'F', 'F')
+#define RIFF_FILE_FOURCC_RF64 RIFF_FILE_FOURCC('R', 'F', '6', '4')
+#define RIFF_FILE_FOURCC_BW64 RIFF_FILE_FOURCC('B', 'W', '6', '4')
+#define RIFF_FILE_FOURCC_DS64 RIFF_FILE_FOURCC('d', 's', '6', '4')
+#define RIFF_FILE_FOURCC_LIST RIFF_FILE_FOURCC('L', 'I', 'S', 'T')
+#define RIFF_FILE_FOURCC_INFO RIFF_FILE_FOURCC('I', 'N', 'F', 'O')
+#define RIFF_FILE_FOURCC_JUNK RIFF_FILE_FOURCC('J', 'U', 'N', 'K')
+#define RIFF_FILE_FOURCC_WAVE RIFF_FILE_FOURCC('W', 'A', 'V', 'E')
+#define RIFF_FILE_FOURCC_FMT  RIFF_FILE_FOURCC('f', 'm', 't', ' ')
+#define RIFF_FILE_FOURCC_DATA RIFF_FILE_FOURCC('d', 'a', 't', 'a')
+#define RIFF_FILE_FOURCC_AVI  RIFF_FILE_FOURCC('A', 'V', 'I', ' ')
+#define RIFF_FILE_FOURCC_HDRL RIFF_FILE_FOURCC('h', 'd', 'r', 'l')
+#define RIFF_FILE_FOURCC_STRL RIFF_FILE_FOURCC('s', 't', 'r', 'l')
+#define RIFF_FILE_FOURCC_MOVI RIFF_FILE_FOURCC('m', 'o', 'v', 'i')
+#define RIFF_FILE_FOURCC_IDX1 RIFF_FILE_FOURCC('i', 'd', 'x', '1')
+#define RIFF_FILE_FOURCC_INDX RIFF_FILE_FOURCC('i', 'n', 'd', 'x')
+#define RIFF_FILE_FOURCC_WEBP RIFF_FILE_FOURCC('W', 'E', 'B', 'P')
+
+// chunk id from 4 ascii characters, compiles to single load on little endian hosts
+//@return id as RIFF_FILE_FOURCC integer, to compare or switch on
+static inline uint32_t riff_file_fourcc(const char id[4])
+{
+  const uint8_t *p = (const uint8_t *)id;
+  return RIFF_FILE_FOURCC(p[0], p[1], p[2], p[3]);
+}
+
 struct riff_file_data_subchunk_s
 {
   // ascii identifier
@@ -30,7 +70,7 @@ struct riff_file_data_subchunk_s
   // variable size field
   uint8_t data[];
 
-  // possibly add a pad byte, if the chunk's length is not even
+  // pad byte follows if the chunk's length is not even, it is not counted in size
 };
 
 struct riff_file_list_chunk_s
@@ -55,33 +95,382 @@ struct riff_file_header_chunk_s
   char format[4];
 };
 
-// handles to RIFF file and iterator
+// chunk index entry, one for every chunk including LIST chunks
+struct riff_file_index_entry_s
+{
+  // file offset of chunk header
+  uint64_t offset;
+  // chunk size as stored in header, 64 bit size from ds64 in RF64/BW64 files,
+  // may run past end of truncated file, reads and views bound it to file
+  uint64_t size;
+  // ascii identifier
+  char id[4];
+  // list type if LIST chunk, otherwise zero
+  char type[4];
+  // list level the chunk is located in
+  int32_t level;
+  // index of parent LIST entry, -1 if top level
+  int32_t parent;
+};
+
+// file access pattern, used as hint for page cache and readahead
+enum riff_file_access_e
+{
+  RIFF_FILE_ACCESS_DEFAULT = 0,
+  // file is read front to back, payload included
+  RIFF_FILE_ACCESS_SEQUENTIAL,
+  // chunks are accessed in random order
+  RIFF_FILE_ACCESS_RANDOM,
+  // only chunk headers are read, file is not mapped
+  RIFF_FILE_ACCESS_HEADERS_ONLY,
+};
+
+// I/O backend used to access file
+enum riff_file_backend_e
+{
+  // whole file memory mapped, chunk pointers available
+  RIFF_FILE_BACKEND_MMAP = 0,
+  // file read with pread, nothing is mapped
+  RIFF_FILE_BACKEND_PREAD,
+  // file read with io_uring, batched reads are submitted together
+  RIFF_FILE_BACKEND_IO_URING,
+};
+
+// options for opening file
+struct riff_file_open_options_s
+{
+  enum riff_file_access_e access;
+  // prefault whole file mapping at open
+  bool populate;
+  // I/O backend, headers only access uses pread unless io_uring is selected
+  enum riff_file_backend_e backend;
+  // keep chunk index in sidecar file "<filename>.rfidx", written when index is
+  // first built and mapped on later opens while file size, mtime and inode match
+  bool index_cache;
+};
+
+// read request, used for reading payload when file is not mapped
+struct riff_file_read_req_s
+{
+  uint64_t offset;
+  void *buf;
+  size_t len;
+  // bytes read, negative errno on failure
+  int64_t result;
+};
+
+// kind of chunk descriptor, list start and end only come from batch iteration
+enum riff_file_chunk_kind_e
+{
+  RIFF_FILE_CHUNK_DATA = 0,
+  // LIST chunk starting, id is list type, offset and size are of LIST chunk
+  RIFF_FILE_CHUNK_LIST_START,
+  // LIST chunk ended, id is "LIST", offset is where list ended, size is zero
+  RIFF_FILE_CHUNK_LIST_END,
+};
+
+// chunk descriptor, computed from chunk headers only
+struct riff_file_chunk_desc_s
+{
+  // file offset of chunk header, payload follows header
+  uint64_t offset;
+  // chunk size as stored in header, 64 bit size from ds64 in RF64/BW64 files,
+  // may run past end of truncated file, reads and views bound it to file
+  uint64_t size;
+  // ascii identifier
+  char id[4];
+  // list level the chunk is located in, for list start and end the level of the LIST chunk itself
+  int32_t level;
+  enum riff_file_chunk_kind_e kind;
+};
+
+// view of chunk payload in mapped file, payload is validated to lie inside mapping
+struct riff_file_chunk_view_s
+{
+  // payload
+  const uint8_t *data;
+  // payload length
+  size_t size;
+  // file offset of chunk header
+  uint64_t offset;
+  // ascii identifier
+  char id[4];
+  // list level the chunk is located in
+  int32_t level;
+};
+
+// iterator counters, only collected when library is built with RIFF_FILE_STATS defined
+struct riff_file_iterator_stats_s
+{
+  // data chunks and LIST chunks stepped over
+  uint64_t chunks;
+  uint64_t lists;
+  // deepest list level reached
+  int32_t  max_level;
+  // bytes of chunk headers and payload stepped over, not including skipped movi payload
+  uint64_t bytes_visited;
+  // payload bytes of AVI movi lists skipped without descending
+  uint64_t bytes_skipped;
+  // list ends moved back because a chunk ran past end of its list
+  uint64_t underflows;
+  // time spent in iterator next calls
+  uint64_t ns;
+};
+
+// error and diagnostic codes
+enum riff_file_error_e
+{
+  RIFF_FILE_ERROR_NONE = 0,
+  // file could not be opened or stat'd
+  RIFF_FILE_ERROR_OPEN,
+  // I/O backend setup failed, mmap or io_uring
+  RIFF_FILE_ERROR_BACKEND,
+  // read failed
+  RIFF_FILE_ERROR_READ,
+  // allocation failed
+  RIFF_FILE_ERROR_NO_MEMORY,
+  // not a RIFF, RF64 or BW64 header, or form type differs, id is id or form type found
+  RIFF_FILE_ERROR_HEADER,
+  // RF64/BW64 file without valid ds64 chunk
+  RIFF_FILE_ERROR_DS64,
+  // chunk runs past end of its list, list is ended at chunk end and parsing goes on
+  RIFF_FILE_ERROR_LIST_UNDERFLOW,
+  // LIST chunks nested deeper than supported
+  RIFF_FILE_ERROR_NESTING_DEPTH,
+  // chunk pointers asked for but file is not mapped
+  RIFF_FILE_ERROR_NOT_MAPPED,
+  // chunk size smaller than its header, stream can not continue, or 64 bit
+  // size from ds64 past end of its list, size is clamped and parsing goes on
+  RIFF_FILE_ERROR_CHUNK_SIZE,
+  // access hint not applied, file is still usable
+  RIFF_FILE_ERROR_ADVISE,
+  // sidecar index could not be written, index is still usable
+  RIFF_FILE_ERROR_INDEX_CACHE,
+  // NULL handle passed
+  RIFF_FILE_ERROR_INVALID_HANDLE,
+  // writer failed to write or back-patch size, writer refuses further writes
+  RIFF_FILE_ERROR_WRITE,
+  // writer call out of order, e.g. LIST end without begin or data outside chunk
+  RIFF_FILE_ERROR_WRITER_STATE,
+  // worker thread could not be started, work goes on with fewer threads
+  RIFF_FILE_ERROR_THREAD,
+  // chunk required by file type not found, id is chunk missing, e.g. WAV fmt or data
+  RIFF_FILE_ERROR_MISSING_CHUNK,
+  // format chunk invalid or format not supported, e.g. WAV fmt
+  RIFF_FILE_ERROR_FORMAT,
+};
+
+// error or diagnostic, recorded on file, iterator or stream handle and passed to log callback
+struct riff_file_diag_s
+{
+  enum riff_file_error_e error;
+  // errno of failed system call, otherwise 0
+  int sys_errno;
+  // file offset of chunk header concerned, 0 if none
+  uint64_t offset;
+  // chunk id concerned, zero if none
+  char id[4];
+  // list level concerned
+  int32_t level;
+};
+
+// log callback, called for every error and diagnostic from any thread
+typedef void (*riff_file_log_fn_t)(const struct riff_file_diag_s *diag, void *user);
+
+// iterator flags
+enum riff_file_iterator_flag_e
+{
+  // descend into AVI "movi" list and its "rec " lists, yielding frame chunks
+  // such as "00dc" and "01wb", by default whole movi list is skipped
+  RIFF_FILE_ITERATOR_DESCEND_MOVI = (1 << 0),
+};
+
+// handles to RIFF file, iterator, chunk index and stream parser
 typedef void* riff_file_h;
 typedef void* riff_file_data_chunk_iterator_h;
+typedef void* riff_file_index_h;
+typedef void* riff_file_stream_h;
 
 // callbacks for LIST chunk starting and ending
 typedef void (*riff_file_list_chunk_start_fn_t)(riff_file_data_chunk_iterator_h iter_h, int level,
                                                 const char type[4], size_t size, const char format[4]);
 typedef void (*riff_file_list_chunk_end_fn_t)(riff_file_data_chunk_iterator_h iter_h, int level);
 
-// open file
+// callbacks for stream parser, any callback may be NULL
+struct riff_file_stream_callbacks_s
+{
+  // LIST chunk starting and ending, same as for iterator
+  void (*list_start)(void *user, int level, const char type[4], size_t size, const char format[4]);
+  void (*list_end)(void *user, int level);
+  // data chunk starting, offset is stream offset of chunk header
+  void (*chunk_start)(void *user, int level, const char id[4], uint64_t size, uint64_t offset);
+  // part of chunk payload, points into buffer given to push and is only valid during call
+  void (*chunk_data)(void *user, const uint8_t *data, size_t len);
+  // data chunk done
+  void (*chunk_end)(void *user);
+};
+
+// open file, NULL type accepts any form type
+// RF64 and BW64 files are accepted too, their 64 bit chunk sizes are taken from ds64 chunk
 riff_file_h riff_file_open(const char *filename, const char type[4]);
 
+// open file with options, NULL options is same as riff_file_open
+riff_file_h riff_file_open_ex(const char *filename, const char type[4],
+                              const struct riff_file_open_options_s *options);
+
+// set log callback for all handles, NULL disables logging, library itself never prints
+// set before files are opened, callback must be safe to call from several threads
+void riff_file_set_log_callback(riff_file_log_fn_t log_fn, void *user);
+
+// pass diagnostic to log callback, used by modules built on top of reader
+void riff_file_log(const struct riff_file_diag_s *diag);
+
+// set error returned by riff_file_get_open_error on calling thread, NULL clears it,
+// used by modules built on top of reader that open files
+void riff_file_set_open_error(const struct riff_file_diag_s *diag);
+
+// short description of error code
+const char* riff_file_error_string(enum riff_file_error_e error);
+
+// get error of last failed riff_file_open or riff_file_writer_open on calling thread, diag may be NULL
+//@return error code, RIFF_FILE_ERROR_NONE if last open succeeded
+enum riff_file_error_e riff_file_get_open_error(struct riff_file_diag_s *diag);
+
+// get last error or diagnostic recorded on file, diag may be NULL
+//@return error code, RIFF_FILE_ERROR_NONE if none
+enum riff_file_error_e riff_file_get_error(riff_file_h file_h, struct riff_file_diag_s *diag);
+
 // create new chunk iterator
 riff_file_data_chunk_iterator_h riff_file_data_chunk_iterator_new(riff_file_h file_h,
                                                                   riff_file_list_chunk_start_fn_t list_start_cb,
                                                                   riff_file_list_chunk_end_fn_t   list_end_cb);
 
-// iterate over file gettting next chunk
-//@return NULL is EOF
+// set iterator flags, see riff_file_iterator_flag_e, call before first chunk is read
+int32_t riff_file_data_chunk_iterator_set_flags(riff_file_data_chunk_iterator_h iter_h, uint32_t flags);
+
+// iterate over file gettting next chunk, size field holds 0xffffffff for RF64/BW64
+// chunks sized in ds64, descriptors and views carry their 64 bit size
+//@return NULL is EOF, also NULL if file is not mapped
 struct riff_file_data_subchunk_s* riff_file_data_chunk_iterator_next(riff_file_data_chunk_iterator_h iter_h);
 
+// iterate over file getting descriptor of next chunk, payload is never touched
+//@return 1 if chunk, 0 is EOF, -1 on read error
+int32_t riff_file_data_chunk_iterator_next_desc(riff_file_data_chunk_iterator_h iter_h,
+                                                struct riff_file_chunk_desc_s *desc);
+
+// iterate over file filling array with descriptors of up to max next chunks,
+// LIST chunk start and end are stored inline in file order, list callbacks are still called
+//@return number of descriptors, 0 is EOF, -1 on read error before any descriptor
+int32_t riff_file_data_chunk_iterator_next_batch(riff_file_data_chunk_iterator_h iter_h,
+                                                 struct riff_file_chunk_desc_s *descs, size_t max);
+
+// iterate over file getting bounds checked view of next chunk payload
+//@return 1 if chunk, 0 is EOF, -1 if chunk exceeds file, file is not mapped or on read error
+int32_t riff_file_data_chunk_iterator_next_view(riff_file_data_chunk_iterator_h iter_h,
+                                                struct riff_file_chunk_view_s *view);
+
 // return current nested list level
 int32_t riff_file_data_chunk_iterator_get_list_level(riff_file_data_chunk_iterator_h iter_h);
 
+// get iterator counters, see riff_file_iterator_stats_s
+//@return 0 on success, -1 if library is built without RIFF_FILE_STATS, stats are zeroed then
+int32_t riff_file_data_chunk_iterator_get_stats(riff_file_data_chunk_iterator_h iter_h,
+                                                struct riff_file_iterator_stats_s *stats);
+
+// get last error or diagnostic recorded on iterator, diag may be NULL
+//@return error code, RIFF_FILE_ERROR_NONE if none
+enum riff_file_error_e riff_file_data_chunk_iterator_get_error(riff_file_data_chunk_iterator_h iter_h,
+                                                               struct riff_file_diag_s *diag);
+
 // delete iterator
 int32_t riff_file_data_chunk_iterator_delete(riff_file_data_chunk_iterator_h iter_h);
 
+// get chunk index, file is walked once on first call and index is kept until file is closed
+// with index cache option a valid sidecar index is used without walking file
+//@return NULL on error
+riff_file_index_h riff_file_index_get(riff_file_h file_h);
+
+// get chunk index built with parallel scan of top level chunks, for large flat files
+// regions of file are scanned on separate threads, 0 threads uses one thread per online CPU
+// threads are limited to online CPUs and to one per 16 MiB of file, so sequential
+// build is used on single CPU machines and for small files, also if file is not mapped
+// index is same as from riff_file_index_get
+//@return NULL on error
+riff_file_index_h riff_file_index_get_parallel(riff_file_h file_h, int32_t threads);
+
+// number of entries in chunk index
+size_t riff_file_index_get_count(riff_file_index_h index_h);
+
+// get index entry n, entries are stored in file order
+//@return NULL if out of range
+const struct riff_file_index_entry_s* riff_file_index_get_entry(riff_file_index_h index_h, size_t n);
+
+// get chunk of index entry n in mapped file
+//@return NULL if out of range or file is not mapped
+struct riff_file_data_subchunk_s* riff_file_index_get_chunk(riff_file_index_h index_h, size_t n);
+
+// find first chunk in index with given id, LIST chunks are found by their list type
+// lookup table is built on first call, lookups are constant time after that
+//@return entry number, -1 if not found
+int32_t riff_file_index_find(riff_file_index_h index_h, const char id[4]);
+
+// same as riff_file_index_find with id given as integer, e.g. RIFF_FILE_FOURCC_MOVI
+//@return entry number, -1 if not found
+int32_t riff_file_index_find_fourcc(riff_file_index_h index_h, uint32_t fourcc);
+
+// find next chunk with same id as entry n
+//@return entry number, -1 if no more chunks
+int32_t riff_file_index_find_next(riff_file_index_h index_h, int32_t n);
+
+// number of chunks in index with given id
+size_t riff_file_index_find_count(riff_file_index_h index_h, const char id[4]);
+
+// get file size
+uint64_t riff_file_get_size(riff_file_h file_h);
+
+// get form type from file header, e.g. "WAVE" or "AVI "
+void riff_file_get_format(riff_file_h file_h, char format[4]);
+
+// get I/O backend file was opened with
+enum riff_file_backend_e riff_file_get_backend(riff_file_h file_h);
+
+// get chunk described by descriptor in mapped file
+//@return NULL if file is not mapped
+struct riff_file_data_subchunk_s* riff_file_get_chunk(riff_file_h file_h, const struct riff_file_chunk_desc_s *desc);
+
+// get bounds checked view of chunk payload described by descriptor
+//@return 1 on success, -1 if chunk exceeds file or file is not mapped
+int32_t riff_file_get_chunk_view(riff_file_h file_h, const struct riff_file_chunk_desc_s *desc,
+                                 struct riff_file_chunk_view_s *view);
+
+// read bytes from file, works with all backends
+//@return 0 on success, -1 if read failed or is out of file range
+int32_t riff_file_read(riff_file_h file_h, uint64_t offset, void *buf, size_t len);
+
+// read several ranges from file, on io_uring backend all reads are queued and submitted together
+//@return 0 if all reads succeeded, -1 otherwise, result of each read is stored in its request
+int32_t riff_file_read_batch(riff_file_h file_h, struct riff_file_read_req_s *reqs, size_t n);
+
+// create stream parser for RIFF data arriving in pieces, e.g. on pipe or socket
+riff_file_stream_h riff_file_stream_new(const char type[4],
+                                        const struct riff_file_stream_callbacks_s *callbacks,
+                                        void *user);
+
+// push next piece of stream, buffers may be split anywhere, only partial headers are kept
+//@return 0 on success, -1 if stream is not valid RIFF
+int32_t riff_file_stream_push(riff_file_stream_h stream_h, const void *buf, size_t len);
+
+// signal end of stream, open lists are ended
+//@return 0 if stream ended after last chunk, -1 if truncated
+int32_t riff_file_stream_finish(riff_file_stream_h stream_h);
+
+// get last error or diagnostic recorded on stream parser, diag may be NULL
+//@return error code, RIFF_FILE_ERROR_NONE if none
+enum riff_file_error_e riff_file_stream_get_error(riff_file_stream_h stream_h, struct riff_file_diag_s *diag);
+
+// delete stream parser
+int32_t riff_file_stream_delete(riff_file_stream_h stream_h);
+
 // close file
 int32_t riff_file_close(riff_file_h file_h);
 
@@ -0,0 +1,272 @@
+/**
+ * Minimal io_uring read queue, used by io_uring backend of RIFF file reader.
+ * Uses io_uring system calls directly, liburing is not needed.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+// for syscall and MAP_POPULATE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/io_uring.h>
+
+#include <riff_file_uring.h>
+
+//------------------------------------------------------------------
+
+// longest single read submitted, sqe length is 32 bit and kernel caps reads below 2 GiB,
+// longer requests are read in several parts
+#define RIFF_FILE_URING_MAX_LEN (1u << 30)
+
+//------------------------------------------------------------------
+
+// Struct describing io_uring instance and its mapped queues
+struct riff_file_uring_s
+{
+  int ring_fd;
+  int fd;
+  uint32_t entries;
+  // submission queue
+  uint32_t *sq_head;
+  uint32_t *sq_tail;
+  uint32_t *sq_mask;
+  uint32_t *sq_array;
+  struct io_uring_sqe *sqes;
+  // completion queue
+  uint32_t *cq_head;
+  uint32_t *cq_tail;
+  uint32_t *cq_mask;
+  struct io_uring_cqe *cqes;
+  // mappings
+  void  *sq_ptr;
+  size_t sq_len;
+  void  *cq_ptr;
+  size_t cq_len;
+  size_t sqes_len;
+  // requests with short completions waiting to be submitted again
+  size_t  *requeue;
+  uint32_t requeue_count;
+};
+
+//------------------------------------------------------------------
+static int uring_setup(uint32_t entries, struct io_uring_params *p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+//------------------------------------------------------------------
+static int uring_enter(int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+  return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+//------------------------------------------------------------------
+struct riff_file_uring_s* riff_file_uring_new(int fd, uint32_t entries)
+{
+  struct riff_file_uring_s *ring = (struct riff_file_uring_s *)calloc(1, sizeof(struct riff_file_uring_s));
+  if (ring == NULL) {
+    return NULL;
+  }
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  ring->ring_fd = uring_setup(entries, &p);
+  if (ring->ring_fd < 0) {
+    free(ring);
+    return NULL;
+  }
+  ring->fd      = fd;
+  ring->entries = p.sq_entries;
+  // each request has at most one read in flight, so requeued requests fit in one ring
+  ring->requeue = (size_t *)malloc(p.sq_entries * sizeof(size_t));
+  if (ring->requeue == NULL) {
+    close(ring->ring_fd);
+    free(ring);
+    return NULL;
+  }
+
+  ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    // both rings share one mapping
+    if (ring->cq_len > ring->sq_len) {
+      ring->sq_len = ring->cq_len;
+    }
+    ring->cq_len = ring->sq_len;
+  }
+
+  ring->sq_ptr = mmap(0, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ptr == MAP_FAILED) {
+    close(ring->ring_fd);
+    free(ring->requeue);
+    free(ring);
+    return NULL;
+  }
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ptr = ring->sq_ptr;
+  }
+  else {
+    ring->cq_ptr = mmap(0, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ptr == MAP_FAILED) {
+      munmap(ring->sq_ptr, ring->sq_len);
+      close(ring->ring_fd);
+      free(ring->requeue);
+      free(ring);
+      return NULL;
+    }
+  }
+
+  ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = (struct io_uring_sqe *)mmap(0, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                           ring->ring_fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    if (ring->cq_ptr != ring->sq_ptr) {
+      munmap(ring->cq_ptr, ring->cq_len);
+    }
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->ring_fd);
+    free(ring->requeue);
+    free(ring);
+    return NULL;
+  }
+
+  char *sq = (char *)ring->sq_ptr;
+  ring->sq_head  = (uint32_t *)(sq + p.sq_off.head);
+  ring->sq_tail  = (uint32_t *)(sq + p.sq_off.tail);
+  ring->sq_mask  = (uint32_t *)(sq + p.sq_off.ring_mask);
+  ring->sq_array = (uint32_t *)(sq + p.sq_off.array);
+
+  char *cq = (char *)ring->cq_ptr;
+  ring->cq_head = (uint32_t *)(cq + p.cq_off.head);
+  ring->cq_tail = (uint32_t *)(cq + p.cq_off.tail);
+  ring->cq_mask = (uint32_t *)(cq + p.cq_off.ring_mask);
+  ring->cqes    = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+  return ring;
+}
+
+//------------------------------------------------------------------
+// queue read of rest of request, result holds bytes read so far
+static void uring_queue(struct riff_file_uring_s *ring, struct riff_file_read_req_s *reqs, size_t i)
+{
+  uint64_t done = (uint64_t)reqs[i].result;
+  uint64_t len  = reqs[i].len - done;
+  if (len > RIFF_FILE_URING_MAX_LEN) {
+    len = RIFF_FILE_URING_MAX_LEN;
+  }
+  uint32_t tail = *ring->sq_tail;
+  uint32_t idx  = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[idx];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode    = IORING_OP_READ;
+  sqe->fd        = ring->fd;
+  sqe->addr      = (uint64_t)(uintptr_t)((char *)reqs[i].buf + done);
+  sqe->len       = (uint32_t)len;
+  sqe->off       = reqs[i].offset + done;
+  sqe->user_data = i;
+  ring->sq_array[idx] = idx;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+//------------------------------------------------------------------
+// reap completions, short reads are put on requeue list, errors and end of file are final
+static uint32_t uring_reap(struct riff_file_uring_s *ring, struct riff_file_read_req_s *reqs)
+{
+  uint32_t reaped = 0;
+  uint32_t head = *ring->cq_head;
+  uint32_t mask = *ring->cq_mask;
+  while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe *cqe = &ring->cqes[head & mask];
+    struct riff_file_read_req_s *req = &reqs[cqe->user_data];
+    if ((cqe->res == -EINTR) || (cqe->res == -EAGAIN)) {
+      ring->requeue[ring->requeue_count++] = (size_t)cqe->user_data;
+    }
+    else if (cqe->res < 0) {
+      req->result = cqe->res;
+    }
+    else if (cqe->res > 0) {
+      req->result += cqe->res;
+      if ((uint64_t)req->result < req->len) {
+        ring->requeue[ring->requeue_count++] = (size_t)cqe->user_data;
+      }
+    }
+    head++;
+    reaped++;
+  }
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  return reaped;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_uring_read(struct riff_file_uring_s *ring, struct riff_file_read_req_s *reqs, size_t n)
+{
+  size_t next = 0;
+  uint32_t inflight = 0;
+  uint32_t queued = 0;
+  ring->requeue_count = 0;
+  while ((next < n) || (inflight > 0) || (ring->requeue_count > 0)) {
+    // queue rest of short reads first, then new requests, as many as ring has room for
+    while ((inflight + queued < ring->entries) && (ring->requeue_count > 0)) {
+      uring_queue(ring, reqs, ring->requeue[--ring->requeue_count]);
+      queued++;
+    }
+    while ((inflight + queued < ring->entries) && (next < n)) {
+      reqs[next].result = 0;
+      if (reqs[next].len > 0) {
+        uring_queue(ring, reqs, next);
+        queued++;
+      }
+      next++;
+    }
+    if ((inflight + queued) == 0) {
+      break;
+    }
+
+    // submit all queued reads at once, then wait for at least one completion
+    int res = uring_enter(ring->ring_fd, queued, 1, IORING_ENTER_GETEVENTS);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    inflight += (uint32_t)res;
+    queued   -= (uint32_t)res;
+    inflight -= uring_reap(ring, reqs);
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+void riff_file_uring_delete(struct riff_file_uring_s *ring)
+{
+  if (ring == NULL) {
+    return;
+  }
+  munmap(ring->sqes, ring->sqes_len);
+  if (ring->cq_ptr != ring->sq_ptr) {
+    munmap(ring->cq_ptr, ring->cq_len);
+  }
+  munmap(ring->sq_ptr, ring->sq_len);
+  close(ring->ring_fd);
+  free(ring->requeue);
+  free(ring);
+}
@@ -0,0 +1,36 @@
+#ifndef _RIFF_FILE_URING_H_
+#define _RIFF_FILE_URING_H_
+
+/**
+ * Minimal io_uring read queue, used by io_uring backend of RIFF file reader.
+ * Uses io_uring system calls directly, liburing is not needed.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <riff_file_reader.h>
+
+struct riff_file_uring_s;
+
+// setup ring for reading from fd, with room for given number of queued reads
+//@return NULL if io_uring is not available
+struct riff_file_uring_s* riff_file_uring_new(int fd, uint32_t entries);
+
+// queue all reads, submit them together and wait for completion
+// short reads are continued until request is complete or end of file is reached,
+// result of each read is stored in its request, bytes read or negative errno
+//@return 0 on success, -1 if submit failed
+int32_t riff_file_uring_read(struct riff_file_uring_s *ring, struct riff_file_read_req_s *reqs, size_t n);
+
+// tear down ring, fd is not closed
+void riff_file_uring_delete(struct riff_file_uring_s *ring);
+
+#endif
@@ -0,0 +1,268 @@
+/**
+ * WAV support for RIFF file reader.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <errno.h>
+
+#include <riff_file_wav.h>
+
+//------------------------------------------------------------------
+
+#define RIFF_FILE_WAV_TYPE_MAGIC  "WAVE"
+
+// WAVEFORMAT with bits per sample, WAVEFORMATEX adds extension size
+#define RIFF_FILE_WAV_FMT_SIZE             (16)
+// WAVEFORMATEXTENSIBLE
+#define RIFF_FILE_WAV_FMT_EXTENSIBLE_SIZE  (40)
+
+//------------------------------------------------------------------
+
+// Struct describing WAV file
+struct riff_file_wav_s
+{
+  riff_file_h file;
+  struct riff_file_wav_format_s format;
+  struct riff_file_chunk_desc_s data;
+};
+
+//------------------------------------------------------------------
+// little endian field loads from unaligned fmt data
+static uint16_t wav_get_u16(const uint8_t *p)
+{
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t wav_get_u32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+//------------------------------------------------------------------
+static enum riff_file_wav_sample_type_e wav_sample_type(uint16_t format_tag, size_t sample_size)
+{
+  if (format_tag == RIFF_FILE_WAV_FORMAT_PCM) {
+    switch (sample_size) {
+    case 1: return RIFF_FILE_WAV_SAMPLE_UINT8;
+    case 2: return RIFF_FILE_WAV_SAMPLE_INT16;
+    case 3: return RIFF_FILE_WAV_SAMPLE_INT24;
+    case 4: return RIFF_FILE_WAV_SAMPLE_INT32;
+    default: break;
+    }
+  }
+  else if (format_tag == RIFF_FILE_WAV_FORMAT_IEEE_FLOAT) {
+    switch (sample_size) {
+    case 4: return RIFF_FILE_WAV_SAMPLE_FLOAT32;
+    case 8: return RIFF_FILE_WAV_SAMPLE_FLOAT64;
+    default: break;
+    }
+  }
+  return RIFF_FILE_WAV_SAMPLE_UNKNOWN;
+}
+
+//------------------------------------------------------------------
+// decode fmt chunk payload
+//@return 0 on success, -1 if not valid
+static int32_t wav_decode_format(struct riff_file_wav_format_s *fmt, const uint8_t *data, uint32_t size)
+{
+  if (size < RIFF_FILE_WAV_FMT_SIZE) {
+    return -1;
+  }
+  memset(fmt, 0, sizeof(struct riff_file_wav_format_s));
+  fmt->format_tag      = wav_get_u16(data);
+  fmt->channels        = wav_get_u16(data + 2);
+  fmt->sample_rate     = wav_get_u32(data + 4);
+  fmt->byte_rate       = wav_get_u32(data + 8);
+  fmt->block_align     = wav_get_u16(data + 12);
+  fmt->bits_per_sample = wav_get_u16(data + 14);
+  fmt->valid_bits_per_sample = fmt->bits_per_sample;
+  if ((fmt->channels == 0) || (fmt->block_align == 0)) {
+    return -1;
+  }
+  if ((fmt->format_tag == RIFF_FILE_WAV_FORMAT_EXTENSIBLE) && (size >= RIFF_FILE_WAV_FMT_EXTENSIBLE_SIZE)) {
+    // sub format guid starts with format tag
+    fmt->extensible   = true;
+    fmt->format_tag   = wav_get_u16(data + 24);
+    fmt->channel_mask = wav_get_u32(data + 20);
+    if (wav_get_u16(data + 18) != 0) {
+      fmt->valid_bits_per_sample = wav_get_u16(data + 18);
+    }
+  }
+  // container size from block alignment, bits per sample may be less than container
+  if ((fmt->block_align % fmt->channels) == 0) {
+    fmt->sample_type = wav_sample_type(fmt->format_tag, fmt->block_align / fmt->channels);
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+// WAV handle is not returned on failure, so reason goes to open error and log
+__attribute__((cold, noinline))
+static void wav_open_report(enum riff_file_error_e error, int sys_errno, uint64_t offset, const char *id)
+{
+  struct riff_file_diag_s d;
+  memset(&d, 0, sizeof(d));
+  d.error     = error;
+  d.sys_errno = sys_errno;
+  d.offset    = offset;
+  if (id != NULL) {
+    memcpy(d.id, id, 4);
+  }
+  riff_file_set_open_error(&d);
+  riff_file_log(&d);
+}
+
+//------------------------------------------------------------------
+riff_file_wav_h riff_file_wav_open(const char *filename, const struct riff_file_open_options_s *options)
+{
+  riff_file_set_open_error(NULL);
+  struct riff_file_wav_s *wav = (struct riff_file_wav_s *)calloc(1, sizeof(struct riff_file_wav_s));
+  if (wav == NULL) {
+    wav_open_report(RIFF_FILE_ERROR_NO_MEMORY, errno, 0, NULL);
+    return NULL;
+  }
+  // open error is recorded by reader
+  wav->file = riff_file_open_ex(filename, RIFF_FILE_WAV_TYPE_MAGIC, options);
+  if (wav->file == NULL) {
+    free(wav);
+    return NULL;
+  }
+  riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(wav->file, NULL, NULL);
+  if (iter_h == NULL) {
+    wav_open_report(RIFF_FILE_ERROR_NO_MEMORY, errno, 0, NULL);
+    riff_file_wav_close(wav);
+    return NULL;
+  }
+  // only headers are walked, fmt is read and data is left for the mapping
+  bool fmt_found  = false;
+  bool data_found = false;
+  struct riff_file_diag_s diag;
+  memset(&diag, 0, sizeof(diag));
+  struct riff_file_chunk_desc_s desc;
+  int32_t res = 0;
+  while ((diag.error == RIFF_FILE_ERROR_NONE) && (!fmt_found || !data_found) &&
+         ((res = riff_file_data_chunk_iterator_next_desc(iter_h, &desc)) > 0)) {
+    if (desc.level != 0) {
+      continue;
+    }
+    switch (riff_file_fourcc(desc.id)) {
+    case RIFF_FILE_FOURCC_FMT:
+      if (!fmt_found) {
+        uint8_t fmt[RIFF_FILE_WAV_FMT_EXTENSIBLE_SIZE];
+        uint32_t len = (desc.size < sizeof(fmt)) ? (uint32_t)desc.size : (uint32_t)sizeof(fmt);
+        if (riff_file_read(wav->file, desc.offset + sizeof(struct riff_file_data_subchunk_s), fmt, len) != 0) {
+          riff_file_get_error(wav->file, &diag);
+          if (diag.error == RIFF_FILE_ERROR_NONE) {
+            diag.error = RIFF_FILE_ERROR_READ;
+          }
+          break;
+        }
+        if (wav_decode_format(&wav->format, fmt, len) != 0) {
+          diag.error  = RIFF_FILE_ERROR_FORMAT;
+          diag.offset = desc.offset;
+          memcpy(diag.id, desc.id, 4);
+          break;
+        }
+        fmt_found = true;
+      }
+      break;
+    case RIFF_FILE_FOURCC_DATA:
+      if (!data_found) {
+        wav->data  = desc;
+        data_found = true;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  // walk failed before required chunks were found
+  if ((diag.error == RIFF_FILE_ERROR_NONE) && (!fmt_found || !data_found) && (res < 0)) {
+    riff_file_data_chunk_iterator_get_error(iter_h, &diag);
+  }
+  riff_file_data_chunk_iterator_delete(iter_h);
+  if (diag.error == RIFF_FILE_ERROR_FORMAT) {
+    wav_open_report(diag.error, diag.sys_errno, diag.offset, diag.id);
+    riff_file_wav_close(wav);
+    return NULL;
+  }
+  if (diag.error != RIFF_FILE_ERROR_NONE) {
+    // read and walk errors are logged by reader already
+    riff_file_set_open_error(&diag);
+    riff_file_wav_close(wav);
+    return NULL;
+  }
+  if (!fmt_found || !data_found) {
+    wav_open_report(RIFF_FILE_ERROR_MISSING_CHUNK, 0, 0, fmt_found ? "data" : "fmt ");
+    riff_file_wav_close(wav);
+    return NULL;
+  }
+  return wav;
+}
+
+//------------------------------------------------------------------
+const struct riff_file_wav_format_s* riff_file_wav_get_format(riff_file_wav_h wav_h)
+{
+  struct riff_file_wav_s *wav = (struct riff_file_wav_s *)wav_h;
+  return &wav->format;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_wav_get_samples(riff_file_wav_h wav_h, struct riff_file_wav_samples_s *samples)
+{
+  struct riff_file_wav_s *wav = (struct riff_file_wav_s *)wav_h;
+  struct riff_file_chunk_view_s view;
+  if (riff_file_get_chunk_view(wav->file, &wav->data, &view) != 1) {
+    return -1;
+  }
+  samples->frame_stride = wav->format.block_align;
+  samples->frame_count  = view.size / samples->frame_stride;
+  samples->data         = view.data;
+  samples->size         = (size_t)samples->frame_count * samples->frame_stride;
+  samples->channels     = wav->format.channels;
+  samples->sample_size  = samples->frame_stride / samples->channels;
+  samples->sample_type  = wav->format.sample_type;
+  return 1;
+}
+
+//------------------------------------------------------------------
+const uint8_t* riff_file_wav_get_frame(const struct riff_file_wav_samples_s *samples, uint64_t n)
+{
+  if (n >= samples->frame_count) {
+    return NULL;
+  }
+  return samples->data + n * samples->frame_stride;
+}
+
+//------------------------------------------------------------------
+riff_file_h riff_file_wav_get_file(riff_file_wav_h wav_h)
+{
+  struct riff_file_wav_s *wav = (struct riff_file_wav_s *)wav_h;
+  return wav->file;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_wav_close(riff_file_wav_h wav_h)
+{
+  struct riff_file_wav_s *wav = (struct riff_file_wav_s *)wav_h;
+  if (wav->file != NULL) {
+    riff_file_close(wav->file);
+  }
+  free(wav);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef _RIFF_FILE_WAV_H_
+#define _RIFF_FILE_WAV_H_
+
+/**
+ * WAV support for RIFF file reader.
+ * Decodes WAVEFORMAT/WAVEFORMATEXTENSIBLE from "fmt " chunk once at open
+ * and gives bounds checked zero-copy access to samples in "data" chunk.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <riff_file_reader.h>
+
+// format tags used in fmt chunk
+#define RIFF_FILE_WAV_FORMAT_PCM        (0x0001)
+#define RIFF_FILE_WAV_FORMAT_IEEE_FLOAT (0x0003)
+#define RIFF_FILE_WAV_FORMAT_EXTENSIBLE (0xfffe)
+
+// sample type, from format tag and container size
+enum riff_file_wav_sample_type_e
+{
+  // compressed or otherwise not plain PCM, samples are opaque blocks
+  RIFF_FILE_WAV_SAMPLE_UNKNOWN = 0,
+  // unsigned 8 bit, 0x80 is silence
+  RIFF_FILE_WAV_SAMPLE_UINT8,
+  RIFF_FILE_WAV_SAMPLE_INT16,
+  // packed 3 byte little endian
+  RIFF_FILE_WAV_SAMPLE_INT24,
+  RIFF_FILE_WAV_SAMPLE_INT32,
+  RIFF_FILE_WAV_SAMPLE_FLOAT32,
+  RIFF_FILE_WAV_SAMPLE_FLOAT64,
+};
+
+// decoded fmt chunk
+struct riff_file_wav_format_s
+{
+  // format tag, for extensible format this is the tag from sub format
+  uint16_t format_tag;
+  bool extensible;
+  uint16_t channels;
+  uint32_t sample_rate;
+  uint32_t byte_rate;
+  // bytes per frame, all channels
+  uint16_t block_align;
+  // container bits per sample
+  uint16_t bits_per_sample;
+  // significant bits per sample, same as container unless extensible format says otherwise
+  uint16_t valid_bits_per_sample;
+  // speaker positions, zero if not extensible
+  uint32_t channel_mask;
+  enum riff_file_wav_sample_type_e sample_type;
+};
+
+// view of samples in mapped data chunk, interleaved frames
+struct riff_file_wav_samples_s
+{
+  // first sample of first frame
+  const uint8_t *data;
+  // bytes in view, whole frames only
+  size_t size;
+  uint64_t frame_count;
+  uint16_t channels;
+  // bytes from one frame to next
+  size_t frame_stride;
+  // bytes per sample of one channel
+  size_t sample_size;
+  enum riff_file_wav_sample_type_e sample_type;
+};
+
+// handle to WAV file
+typedef void* riff_file_wav_h;
+
+// open WAV file, fmt chunk is decoded and data chunk located, NULL options is default
+//@return NULL if file is not WAVE or has no valid fmt and data chunks, see riff_file_get_open_error
+riff_file_wav_h riff_file_wav_open(const char *filename, const struct riff_file_open_options_s *options);
+
+// get decoded format
+const struct riff_file_wav_format_s* riff_file_wav_get_format(riff_file_wav_h wav_h);
+
+// get view of samples
+//@return 1 on success, -1 if data chunk exceeds file or file is not mapped
+int32_t riff_file_wav_get_samples(riff_file_wav_h wav_h, struct riff_file_wav_samples_s *samples);
+
+// get pointer to frame n of sample view
+//@return NULL if out of range
+const uint8_t* riff_file_wav_get_frame(const struct riff_file_wav_samples_s *samples, uint64_t n);
+
+// get underlying RIFF file, e.g. for reading other chunks
+riff_file_h riff_file_wav_get_file(riff_file_wav_h wav_h);
+
+// close WAV file
+int32_t riff_file_wav_close(riff_file_wav_h wav_h);
+
+#endif
@@ -0,0 +1,530 @@
+/**
+ * Streaming RIFF file writer.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+// for pwritev and posix_memalign
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <riff_file_writer.h>
+
+//------------------------------------------------------------------
+
+#define RIFF_FILE_WRITER_LIST_MAGIC  "LIST"
+#define RIFF_FILE_WRITER_RIFF_MAGIC  "RIFF"
+
+// buffer is written in whole blocks, page aligned so blocks go to page cache without split pages
+#define RIFF_FILE_WRITER_BUFFER_SIZE   (1 << 20)
+#define RIFF_FILE_WRITER_BUFFER_ALIGN  (4096)
+
+// payloads this large are not copied, they are written from user buffers together with buffer
+#define RIFF_FILE_WRITER_DIRECT_SIZE   (64 * 1024)
+
+// user buffers gathered on stack, more than this are allocated
+#define RIFF_FILE_WRITER_IOV_LOCAL     (16)
+// buffers passed to each pwritev, below IOV_MAX
+#define RIFF_FILE_WRITER_IOV_BATCH     (64)
+
+// open LIST levels kept inline, deeper nesting grows on heap
+#define RIFF_FILE_WRITER_INLINE_LEVELS (16)
+
+//------------------------------------------------------------------
+
+// Struct describing RIFF file being written
+struct riff_file_writer_s
+{
+  int fd;
+  // buffered bytes, file offset of first buffered byte
+  uint8_t *buf;
+  size_t   buf_len;
+  uint64_t buf_offset;
+  // header offsets of RIFF chunk at level 0 and open LIST chunks, innermost last
+  uint64_t *open;
+  int32_t  open_count;
+  int32_t  open_capacity;
+  uint64_t open_inline[RIFF_FILE_WRITER_INLINE_LEVELS];
+  // chunk begun with riff_file_writer_chunk_begin
+  bool     chunk_open;
+  uint64_t chunk_offset;
+  char     chunk_id[4];
+  // first error, writes are refused after write error
+  struct riff_file_diag_s diag;
+};
+
+//------------------------------------------------------------------
+// record first error and pass every error to log callback
+__attribute__((cold, noinline))
+static int32_t writer_report(struct riff_file_writer_s *w, enum riff_file_error_e error, int sys_errno,
+                             uint64_t offset, const char *id)
+{
+  struct riff_file_diag_s d;
+  d.error     = error;
+  d.sys_errno = sys_errno;
+  d.offset    = offset;
+  if (id != NULL) {
+    memcpy(d.id, id, 4);
+  }
+  else {
+    memset(d.id, 0, 4);
+  }
+  d.level = (w != NULL) ? (w->open_count - 1) : 0;
+  if ((w != NULL) && (w->diag.error == RIFF_FILE_ERROR_NONE)) {
+    w->diag = d;
+  }
+  riff_file_log(&d);
+  return -1;
+}
+
+//------------------------------------------------------------------
+// failed open has no handle, error is kept as open error of calling thread
+__attribute__((cold, noinline))
+static void writer_open_report(enum riff_file_error_e error, int sys_errno)
+{
+  struct riff_file_diag_s d;
+  memset(&d, 0, sizeof(d));
+  d.error     = error;
+  d.sys_errno = sys_errno;
+  riff_file_set_open_error(&d);
+  riff_file_log(&d);
+}
+
+//------------------------------------------------------------------
+static inline uint64_t writer_offset(const struct riff_file_writer_s *w)
+{
+  return w->buf_offset + w->buf_len;
+}
+
+//------------------------------------------------------------------
+// write all buffers at offset, restarting after short writes
+//@return 0 on success, -1 with errno set on error
+static int32_t writer_pwritev(int fd, const struct iovec *iov, int iovcnt, uint64_t offset)
+{
+  struct iovec v[RIFF_FILE_WRITER_IOV_BATCH];
+  const int batch = (int)(sizeof(v) / sizeof(v[0]));
+  int i = 0;
+  // bytes of iov[i] already written
+  size_t skip = 0;
+  while (i < iovcnt) {
+    int n = 0;
+    while ((i + n < iovcnt) && (n < batch)) {
+      v[n] = iov[i + n];
+      n++;
+    }
+    v[0].iov_base = (uint8_t *)v[0].iov_base + skip;
+    v[0].iov_len -= skip;
+    ssize_t r = pwritev(fd, v, n, (off_t)offset);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    offset += (uint64_t)r;
+    size_t left = (size_t)r + skip;
+    int first = i;
+    while ((i < iovcnt) && (left >= iov[i].iov_len)) {
+      left -= iov[i].iov_len;
+      i++;
+    }
+    skip = left;
+    if ((r == 0) && (i == first)) {
+      errno = EIO;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+static int32_t writer_flush(struct riff_file_writer_s *w)
+{
+  if (w->buf_len == 0) {
+    return 0;
+  }
+  struct iovec iov = { w->buf, w->buf_len };
+  if (writer_pwritev(w->fd, &iov, 1, w->buf_offset) != 0) {
+    return writer_report(w, RIFF_FILE_ERROR_WRITE, errno, w->buf_offset, NULL);
+  }
+  w->buf_offset += w->buf_len;
+  w->buf_len = 0;
+  return 0;
+}
+
+//------------------------------------------------------------------
+// copy into buffer, buffer is written each time it is full
+static int32_t writer_put(struct riff_file_writer_s *w, const void *data, size_t len)
+{
+  const uint8_t *p = (const uint8_t *)data;
+  while (len > 0) {
+    size_t n = RIFF_FILE_WRITER_BUFFER_SIZE - w->buf_len;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(w->buf + w->buf_len, p, n);
+    w->buf_len += n;
+    p   += n;
+    len -= n;
+    if ((w->buf_len == RIFF_FILE_WRITER_BUFFER_SIZE) && (writer_flush(w) != 0)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+// write payload, small payloads are copied into buffer,
+// large ones are written from user buffers in same system call as buffered bytes,
+// up to last block boundary, rest of payload is copied so buffer stays block aligned
+static int32_t writer_payload(struct riff_file_writer_s *w, const struct iovec *iov, int iovcnt, size_t size)
+{
+  int i;
+  if (size < RIFF_FILE_WRITER_DIRECT_SIZE) {
+    for (i = 0; i < iovcnt; i++) {
+      if (writer_put(w, iov[i].iov_base, iov[i].iov_len) != 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+  struct iovec local[RIFF_FILE_WRITER_IOV_LOCAL];
+  struct iovec *v = local;
+  if (iovcnt >= RIFF_FILE_WRITER_IOV_LOCAL) {
+    v = (struct iovec *)malloc((size_t)(iovcnt + 1) * sizeof(struct iovec));
+    if (v == NULL) {
+      return writer_report(w, RIFF_FILE_ERROR_NO_MEMORY, errno, writer_offset(w), NULL);
+    }
+  }
+  v[0].iov_base = w->buf;
+  v[0].iov_len  = w->buf_len;
+  memcpy(v + 1, iov, (size_t)iovcnt * sizeof(struct iovec));
+  // tail is smaller than block and payload is larger, so tail is cut from user buffers only
+  uint64_t end = w->buf_offset + w->buf_len + size;
+  size_t tail = (size_t)(end % RIFF_FILE_WRITER_BUFFER_ALIGN);
+  int n = iovcnt + 1;
+  size_t cut = tail;
+  while (cut > 0) {
+    if (v[n - 1].iov_len > cut) {
+      v[n - 1].iov_len -= cut;
+      cut = 0;
+    }
+    else {
+      cut -= v[n - 1].iov_len;
+      n--;
+    }
+  }
+  int32_t res = writer_pwritev(w->fd, v, n, w->buf_offset);
+  int sys_errno = errno;
+  if (v != local) {
+    free(v);
+  }
+  if (res != 0) {
+    return writer_report(w, RIFF_FILE_ERROR_WRITE, sys_errno, w->buf_offset, NULL);
+  }
+  // copy tail to start of buffer, from end of last user buffers
+  size_t left = tail;
+  i = iovcnt;
+  while (left > 0) {
+    i--;
+    size_t len = (iov[i].iov_len < left) ? iov[i].iov_len : left;
+    left -= len;
+    memcpy(w->buf + left, (const uint8_t *)iov[i].iov_base + iov[i].iov_len - len, len);
+  }
+  w->buf_offset = end - tail;
+  w->buf_len    = tail;
+  return 0;
+}
+
+//------------------------------------------------------------------
+// overwrite bytes already written, in buffer if still buffered, otherwise in file
+static int32_t writer_patch(struct riff_file_writer_s *w, uint64_t offset, const void *data, size_t len)
+{
+  const uint8_t *p = (const uint8_t *)data;
+  if (offset < w->buf_offset) {
+    size_t n = (w->buf_offset - offset < len) ? (size_t)(w->buf_offset - offset) : len;
+    struct iovec iov = { (void *)p, n };
+    if (writer_pwritev(w->fd, &iov, 1, offset) != 0) {
+      return writer_report(w, RIFF_FILE_ERROR_WRITE, errno, offset, NULL);
+    }
+    p      += n;
+    offset += n;
+    len    -= n;
+  }
+  if (len > 0) {
+    memcpy(w->buf + (offset - w->buf_offset), p, len);
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+// back-patch size field of chunk header at offset, chunk ends at current offset
+static int32_t writer_patch_size(struct riff_file_writer_s *w, uint64_t hdr_offset, const char *id)
+{
+  uint64_t size = writer_offset(w) - hdr_offset - sizeof(struct riff_file_data_subchunk_s);
+  if (size > UINT32_MAX) {
+    return writer_report(w, RIFF_FILE_ERROR_CHUNK_SIZE, 0, hdr_offset, id);
+  }
+  uint32_t size32 = (uint32_t)size;
+  return writer_patch(w, hdr_offset + offsetof(struct riff_file_data_subchunk_s, size), &size32, sizeof(size32));
+}
+
+//------------------------------------------------------------------
+static int32_t writer_header(struct riff_file_writer_s *w, const char id[4], uint32_t size)
+{
+  struct riff_file_data_subchunk_s hdr;
+  memcpy(hdr.id, id, 4);
+  hdr.size = size;
+  return writer_put(w, &hdr, sizeof(hdr));
+}
+
+//------------------------------------------------------------------
+static int32_t writer_pad(struct riff_file_writer_s *w)
+{
+  static const uint8_t pad = 0;
+  if ((writer_offset(w) & 1) != 0) {
+    return writer_put(w, &pad, 1);
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+// writer may take new chunk, no chunk is begun and no write has failed
+static int32_t writer_ready(struct riff_file_writer_s *w, const char *id)
+{
+  if (w == NULL) {
+    return writer_report(NULL, RIFF_FILE_ERROR_INVALID_HANDLE, 0, 0, id);
+  }
+  if (w->diag.error == RIFF_FILE_ERROR_WRITE) {
+    return -1;
+  }
+  if (w->chunk_open) {
+    return writer_report(w, RIFF_FILE_ERROR_WRITER_STATE, 0, w->chunk_offset, w->chunk_id);
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------
+riff_file_writer_h riff_file_writer_open(const char *filename, const char format[4])
+{
+  riff_file_set_open_error(NULL);
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)calloc(1, sizeof(struct riff_file_writer_s));
+  if (w == NULL) {
+    writer_open_report(RIFF_FILE_ERROR_NO_MEMORY, errno);
+    return NULL;
+  }
+  void *buf = NULL;
+  int res = posix_memalign(&buf, RIFF_FILE_WRITER_BUFFER_ALIGN, RIFF_FILE_WRITER_BUFFER_SIZE);
+  if (res != 0) {
+    free(w);
+    writer_open_report(RIFF_FILE_ERROR_NO_MEMORY, res);
+    return NULL;
+  }
+  w->buf = (uint8_t *)buf;
+  w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (w->fd < 0) {
+    writer_open_report(RIFF_FILE_ERROR_OPEN, errno);
+    free(w->buf);
+    free(w);
+    return NULL;
+  }
+  w->open          = w->open_inline;
+  w->open_capacity = RIFF_FILE_WRITER_INLINE_LEVELS;
+  w->open_count    = 1;
+  w->open[0]       = 0;
+  // size is patched at close
+  struct riff_file_header_chunk_s hdr;
+  memcpy(hdr.id, RIFF_FILE_WRITER_RIFF_MAGIC, 4);
+  hdr.size = 0;
+  memcpy(hdr.format, format, 4);
+  writer_put(w, &hdr, sizeof(hdr));
+  return w;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_writer_list_begin(riff_file_writer_h writer_h, const char type[4])
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  if (writer_ready(w, RIFF_FILE_WRITER_LIST_MAGIC) != 0) {
+    return -1;
+  }
+  if (w->open_count == w->open_capacity) {
+    int32_t capacity = w->open_capacity * 2;
+    uint64_t *open = (uint64_t *)malloc((size_t)capacity * sizeof(uint64_t));
+    if (open == NULL) {
+      return writer_report(w, RIFF_FILE_ERROR_NO_MEMORY, errno, writer_offset(w), RIFF_FILE_WRITER_LIST_MAGIC);
+    }
+    memcpy(open, w->open, (size_t)w->open_count * sizeof(uint64_t));
+    if (w->open != w->open_inline) {
+      free(w->open);
+    }
+    w->open          = open;
+    w->open_capacity = capacity;
+  }
+  w->open[w->open_count++] = writer_offset(w);
+  // size is patched at list end
+  struct riff_file_list_chunk_s hdr;
+  memcpy(hdr.id, RIFF_FILE_WRITER_LIST_MAGIC, 4);
+  hdr.size = 0;
+  memcpy(hdr.type, type, 4);
+  return writer_put(w, &hdr, sizeof(hdr));
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_writer_list_end(riff_file_writer_h writer_h)
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  if (writer_ready(w, RIFF_FILE_WRITER_LIST_MAGIC) != 0) {
+    return -1;
+  }
+  if (w->open_count <= 1) {
+    return writer_report(w, RIFF_FILE_ERROR_WRITER_STATE, 0, writer_offset(w), RIFF_FILE_WRITER_LIST_MAGIC);
+  }
+  w->open_count--;
+  return writer_patch_size(w, w->open[w->open_count], RIFF_FILE_WRITER_LIST_MAGIC);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_writer_chunk(riff_file_writer_h writer_h, const char id[4], const void *data, size_t size)
+{
+  struct iovec iov = { (void *)data, size };
+  return riff_file_writer_chunkv(writer_h, id, &iov, 1);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_writer_chunkv(riff_file_writer_h writer_h, const char id[4], const struct iovec *iov, int iovcnt)
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  if (writer_ready(w, id) != 0) {
+    return -1;
+  }
+  size_t size = 0;
+  int i;
+  for (i = 0; i < iovcnt; i++) {
+    size += iov[i].iov_len;
+  }
+  if (size > UINT32_MAX) {
+    return writer_report(w, RIFF_FILE_ERROR_CHUNK_SIZE, 0, writer_offset(w), id);
+  }
+  if ((writer_header(w, id, (uint32_t)size) != 0) ||
+      (writer_payload(w, iov, iovcnt, size) != 0)) {
+    return -1;
+  }
+  return writer_pad(w);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_writer_chunk_begin(riff_file_writer_h writer_h, const char id[4])
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  if (writer_ready(w, id) != 0) {
+    return -1;
+  }
+  w->chunk_open   = true;
+  w->chunk_offset = writer_offset(w);
+  memcpy(w->chunk_id, id, 4);
+  // size is patched at chunk end
+  return writer_header(w, id, 0);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_writer_chunk_write(riff_file_writer_h writer_h, const void *data, size_t size)
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  if (w == NULL) {
+    return writer_report(NULL, RIFF_FILE_ERROR_INVALID_HANDLE, 0, 0, NULL);
+  }
+  if (w->diag.error == RIFF_FILE_ERROR_WRITE) {
+    return -1;
+  }
+  if (!w->chunk_open) {
+    return writer_report(w, RIFF_FILE_ERROR_WRITER_STATE, 0, writer_offset(w), NULL);
+  }
+  struct iovec iov = { (void *)data, size };
+  return writer_payload(w, &iov, 1, size);
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_writer_chunk_end(riff_file_writer_h writer_h)
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  if (w == NULL) {
+    return writer_report(NULL, RIFF_FILE_ERROR_INVALID_HANDLE, 0, 0, NULL);
+  }
+  if (w->diag.error == RIFF_FILE_ERROR_WRITE) {
+    return -1;
+  }
+  if (!w->chunk_open) {
+    return writer_report(w, RIFF_FILE_ERROR_WRITER_STATE, 0, writer_offset(w), NULL);
+  }
+  w->chunk_open = false;
+  // size excludes pad byte, so patch before padding
+  if (writer_patch_size(w, w->chunk_offset, w->chunk_id) != 0) {
+    return -1;
+  }
+  return writer_pad(w);
+}
+
+//------------------------------------------------------------------
+uint64_t riff_file_writer_get_offset(riff_file_writer_h writer_h)
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  return writer_offset(w);
+}
+
+//------------------------------------------------------------------
+enum riff_file_error_e riff_file_writer_get_error(riff_file_writer_h writer_h, struct riff_file_diag_s *diag)
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  if (diag != NULL) {
+    *diag = w->diag;
+  }
+  return w->diag.error;
+}
+
+//------------------------------------------------------------------
+int32_t riff_file_writer_close(riff_file_writer_h writer_h)
+{
+  struct riff_file_writer_s *w = (struct riff_file_writer_s *)writer_h;
+  if (w == NULL) {
+    return writer_report(NULL, RIFF_FILE_ERROR_INVALID_HANDLE, 0, 0, NULL);
+  }
+  if (w->diag.error != RIFF_FILE_ERROR_WRITE) {
+    if (w->chunk_open) {
+      riff_file_writer_chunk_end(w);
+    }
+    while (w->open_count > 1) {
+      riff_file_writer_list_end(w);
+    }
+    // RIFF size patched before last flush, small files are written with one system call
+    writer_patch_size(w, 0, RIFF_FILE_WRITER_RIFF_MAGIC);
+    writer_flush(w);
+  }
+  if (close(w->fd) != 0) {
+    writer_report(w, RIFF_FILE_ERROR_WRITE, errno, 0, NULL);
+  }
+  int32_t res = (w->diag.error == RIFF_FILE_ERROR_NONE) ? 0 : -1;
+  if (w->open != w->open_inline) {
+    free(w->open);
+  }
+  free(w->buf);
+  free(w);
+  return res;
+}
@@ -0,0 +1,74 @@
+#ifndef _RIFF_FILE_WRITER_H_
+#define _RIFF_FILE_WRITER_H_
+
+/**
+ * Streaming RIFF file writer.
+ * Chunk headers and small payloads are gathered in a large page aligned buffer
+ * written in whole blocks, large payloads go straight from user buffers with
+ * pwritev. RIFF, LIST and chunk sizes are back-patched when their chunk ends,
+ * in buffer if header is still buffered, otherwise with pwrite.
+ *
+ * This file is in the public domain.
+ * You can do whatever you want with it.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/uio.h>
+
+#include <riff_file_reader.h>
+
+// handle to RIFF file being written
+typedef void* riff_file_writer_h;
+
+// create or truncate file and write RIFF header with given form type, e.g. "WAVE"
+//@return NULL on error, see riff_file_get_open_error
+riff_file_writer_h riff_file_writer_open(const char *filename, const char format[4]);
+
+// begin LIST chunk with given list type, e.g. "hdrl" or "movi"
+//@return 0 on success, -1 on error
+int32_t riff_file_writer_list_begin(riff_file_writer_h writer_h, const char type[4]);
+
+// end innermost LIST chunk and back-patch its size
+//@return 0 on success, -1 on error or if no LIST is open
+int32_t riff_file_writer_list_end(riff_file_writer_h writer_h);
+
+// write complete chunk, pad byte is added after odd sized payload
+//@return 0 on success, -1 on error
+int32_t riff_file_writer_chunk(riff_file_writer_h writer_h, const char id[4], const void *data, size_t size);
+
+// write complete chunk gathered from several buffers,
+// large payloads are written directly from buffers without copying
+//@return 0 on success, -1 on error
+int32_t riff_file_writer_chunkv(riff_file_writer_h writer_h, const char id[4], const struct iovec *iov, int iovcnt);
+
+// begin chunk of size not known yet, e.g. streamed "data" chunk
+//@return 0 on success, -1 on error
+int32_t riff_file_writer_chunk_begin(riff_file_writer_h writer_h, const char id[4]);
+
+// append payload to chunk begun with riff_file_writer_chunk_begin
+//@return 0 on success, -1 on error or if no chunk is begun
+int32_t riff_file_writer_chunk_write(riff_file_writer_h writer_h, const void *data, size_t size);
+
+// end chunk begun with riff_file_writer_chunk_begin, back-patch its size and pad it
+//@return 0 on success, -1 on error or if no chunk is begun
+int32_t riff_file_writer_chunk_end(riff_file_writer_h writer_h);
+
+// get file offset where next chunk header will be written, e.g. for AVI idx1 entries
+uint64_t riff_file_writer_get_offset(riff_file_writer_h writer_h);
+
+// get first error recorded on writer, diag may be NULL
+//@return error code, RIFF_FILE_ERROR_NONE if none
+enum riff_file_error_e riff_file_writer_get_error(riff_file_writer_h writer_h, struct riff_file_diag_s *diag);
+
+// end open chunk and LIST chunks, flush buffer, back-patch RIFF size and close file
+//@return 0 if whole file was written, -1 if any error occurred
+int32_t riff_file_writer_close(riff_file_writer_h writer_h);
+
+#endif
@@ -5,6 +5,8 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 
 #include <riff_file_reader.h>
 
@@ -35,13 +37,81 @@ static void riff_file_list_chunk_end_fn(riff_file_data_chunk_iterator_h iter_h,
   indent(level); printf(" b--LIST.END[%d].\n", level);
 }
 
+//--------------------------------------------------
+static void riff_file_log_fn(const struct riff_file_diag_s *diag, void *user)
+{
+  char id[5];
+  int i;
+  for (i = 0; i < 4; i++) {
+    id[i] = isprint((unsigned char)diag->id[i]) ? diag->id[i] : '.';
+  }
+  id[4] = '\0';
+  fprintf(stderr, "riff error: %s, offset %llu id <%s> level %d%s%s\n",
+          riff_file_error_string(diag->error), (unsigned long long)diag->offset, id, (int)diag->level,
+          (diag->sys_errno != 0) ? ", " : "", (diag->sys_errno != 0) ? strerror(diag->sys_errno) : "");
+}
+
+//--------------------------------------------------
+static void dump_headers(riff_file_data_chunk_iterator_h iter_h)
+{
+  struct riff_file_chunk_desc_s desc;
+  printf("---------------------------------------\n");
+  while (riff_file_data_chunk_iterator_next_desc(iter_h, &desc) > 0) {
+    indent(desc.level+1); printf("....CHUNK: ID <%c%c%c%c> SIZE(%llu) OFFSET(%llu)\n",
+                                 desc.id[0], desc.id[1], desc.id[2], desc.id[3],
+                                 (unsigned long long)desc.size,
+                                 (unsigned long long)desc.offset);
+  }
+  printf("EOF.\n");
+  // only when built with iterator counters
+  struct riff_file_iterator_stats_s stats;
+  if (riff_file_data_chunk_iterator_get_stats(iter_h, &stats) == 0) {
+    printf("STATS: chunks %llu lists %llu max level %d visited %llu skipped %llu underflows %llu time %llu ns\n",
+           (unsigned long long)stats.chunks, (unsigned long long)stats.lists, (int)stats.max_level,
+           (unsigned long long)stats.bytes_visited, (unsigned long long)stats.bytes_skipped,
+           (unsigned long long)stats.underflows, (unsigned long long)stats.ns);
+  }
+  printf("---------------------------------------\n");
+}
+
+//--------------------------------------------------
+static void dump_batch(riff_file_data_chunk_iterator_h iter_h)
+{
+  struct riff_file_chunk_desc_s descs[16];
+  int32_t n;
+  int32_t i;
+  printf("---------------------------------------\n");
+  while ((n = riff_file_data_chunk_iterator_next_batch(iter_h, descs, 16)) > 0) {
+    for (i = 0; i < n; i++) {
+      const struct riff_file_chunk_desc_s *d = &descs[i];
+      switch (d->kind) {
+      case RIFF_FILE_CHUNK_LIST_START:
+        indent(d->level+1); printf(" p--LIST.START[%d]: FORMAT <%c%c%c%c> SIZE(%llu) OFFSET(%llu)\n",
+                                   d->level+1, d->id[0], d->id[1], d->id[2], d->id[3],
+                                   (unsigned long long)d->size, (unsigned long long)d->offset);
+        break;
+      case RIFF_FILE_CHUNK_LIST_END:
+        indent(d->level+1); printf(" b--LIST.END[%d].\n", d->level+1);
+        break;
+      default:
+        indent(d->level+1); printf("....CHUNK: ID <%c%c%c%c> SIZE(%llu) OFFSET(%llu)\n",
+                                   d->id[0], d->id[1], d->id[2], d->id[3],
+                                   (unsigned long long)d->size, (unsigned long long)d->offset);
+        break;
+      }
+    }
+  }
+  printf("EOF.\n");
+  printf("---------------------------------------\n");
+}
+
 //--------------------------------------------------
 int main (int argc, char **argv)
 {
   printf("RIFF file reader test\n");
 
   if (argc < 3) {
-    printf("Usage: %s filename type\n", argv[0]);
+    printf("Usage: %s filename type [headers|movi|batch]\n", argv[0]);
     return 0;
   }
 
@@ -54,13 +124,43 @@ int main (int argc, char **argv)
 
   printf("Filename %s filename type %c%c%c%c\n",
          filename, type[0], type[1], type[2], type[3]);
+
+  // library does not print, errors and diagnostics are logged here
+  riff_file_set_log_callback(riff_file_log_fn, NULL);
   
-  riff_file_h rf = riff_file_open(filename, type);
-  if (rf != NULL) {
+  // headers only, file is not mapped and payload is not read
+  bool headers_only = (argc > 3) && (strcmp(argv[3], "headers") == 0);
+  // list AVI frame chunks in movi list
+  bool movi = (argc > 3) && (strcmp(argv[3], "movi") == 0);
+  // descriptors in batches with LIST start and end inline
+  bool batch = (argc > 3) && (strcmp(argv[3], "batch") == 0);
+  struct riff_file_open_options_s options = { RIFF_FILE_ACCESS_DEFAULT, false, RIFF_FILE_BACKEND_MMAP, false };
+  if (headers_only) {
+    options.access = RIFF_FILE_ACCESS_HEADERS_ONLY;
+  }
+
+  riff_file_h rf = riff_file_open_ex(filename, type, &options);
+  if ((rf != NULL) && batch) {
+    riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf, NULL, NULL);
+    if (iter_h != NULL) {
+      dump_batch(iter_h);
+      riff_file_data_chunk_iterator_delete(iter_h);
+    }
+    riff_file_close(rf);
+  }
+  else if (rf != NULL) {
     riff_file_data_chunk_iterator_h iter_h = riff_file_data_chunk_iterator_new(rf,
                                                                                riff_file_list_chunk_start_fn,
                                                                                riff_file_list_chunk_end_fn);
-    if (iter_h != NULL) {
+    if ((iter_h != NULL) && (headers_only || movi)) {
+      if (movi) {
+        riff_file_data_chunk_iterator_set_flags(iter_h, RIFF_FILE_ITERATOR_DESCEND_MOVI);
+      }
+      dump_headers(iter_h);
+      riff_file_data_chunk_iterator_delete(iter_h);
+      riff_file_close(rf);
+    }
+    else if (iter_h != NULL) {
       struct riff_file_data_subchunk_s* chunk;
       printf("---------------------------------------\n");
       do {